@@ -6,8 +6,8 @@
 using namespace Rcpp;
 
 // adult_weight_wrapper
-List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, double days, bool checkValues);
-RcppExport SEXP _bw_adult_weight_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP daysSEXP, SEXP checkValuesSEXP) {
+List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, double days, bool checkValues, int threads, List output, List knots, List solver, List checkpoints);
+RcppExport SEXP _bw_adult_weight_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP threadsSEXP, SEXP outputSEXP, SEXP knotsSEXP, SEXP solverSEXP, SEXP checkpointsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -23,13 +23,18 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, days, checkValues));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type checkpoints(checkpointsSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, days, checkValues, threads, output, knots, solver, checkpoints));
     return rcpp_result_gen;
 END_RCPP
 }
 // adult_weight_wrapper_EI
-List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector extradata, double days, bool checkValues, bool isEnergy);
-RcppExport SEXP _bw_adult_weight_wrapper_EI(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP extradataSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP isEnergySEXP) {
+List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector extradata, double days, bool checkValues, bool isEnergy, int threads, List output, List knots, List solver, List checkpoints);
+RcppExport SEXP _bw_adult_weight_wrapper_EI(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP extradataSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP isEnergySEXP, SEXP threadsSEXP, SEXP outputSEXP, SEXP knotsSEXP, SEXP solverSEXP, SEXP checkpointsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -47,13 +52,18 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
     Rcpp::traits::input_parameter< bool >::type isEnergy(isEnergySEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, extradata, days, checkValues, isEnergy));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type checkpoints(checkpointsSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, extradata, days, checkValues, isEnergy, threads, output, knots, solver, checkpoints));
     return rcpp_result_gen;
 END_RCPP
 }
 // adult_weight_wrapper_EI_fat
-List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, bool checkValues);
-RcppExport SEXP _bw_adult_weight_wrapper_EI_fat(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP checkValuesSEXP) {
+List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, bool checkValues, int threads, List output, List knots, List solver, List checkpoints);
+RcppExport SEXP _bw_adult_weight_wrapper_EI_fat(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP threadsSEXP, SEXP outputSEXP, SEXP knotsSEXP, SEXP solverSEXP, SEXP checkpointsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -71,13 +81,76 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< NumericVector >::type input_fat(input_fatSEXP);
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI_fat(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, checkValues));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type checkpoints(checkpointsSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_wrapper_EI_fat(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, checkValues, threads, output, knots, solver, checkpoints));
+    return rcpp_result_gen;
+END_RCPP
+}
+// adult_weight_scenarios_wrapper
+List adult_weight_scenarios_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix PAL_base, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, int nscenarios, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, double days, bool checkValues, int threads, List output, List knots, List solver);
+RcppExport SEXP _bw_adult_weight_scenarios_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP PAL_baseSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP nscenariosSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP threadsSEXP, SEXP outputSEXP, SEXP knotsSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type bw(bwSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ht(htSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type PAL_base(PAL_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb_base(pcarb_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb(pcarbSEXP);
+    Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_EI(input_EISEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_fat(input_fatSEXP);
+    Rcpp::traits::input_parameter< int >::type nscenarios(nscenariosSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type EIchange(EIchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type NAchange(NAchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type PAL(PALSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_scenarios_wrapper(bw, ht, age, sex, PAL_base, pcarb_base, pcarb, dt, input_EI, input_fat, nscenarios, EIchange, NAchange, PAL, days, checkValues, threads, output, knots, solver));
+    return rcpp_result_gen;
+END_RCPP
+}
+// adult_weight_target_wrapper
+List adult_weight_target_wrapper(NumericVector bw, NumericVector ht, NumericVector age, NumericVector sex, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double dt, NumericVector input_EI, NumericVector input_fat, double days, bool checkValues, int threads, List target, List knots, List solver);
+RcppExport SEXP _bw_adult_weight_target_wrapper(SEXP bwSEXP, SEXP htSEXP, SEXP ageSEXP, SEXP sexSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP dtSEXP, SEXP input_EISEXP, SEXP input_fatSEXP, SEXP daysSEXP, SEXP checkValuesSEXP, SEXP threadsSEXP, SEXP targetSEXP, SEXP knotsSEXP, SEXP solverSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type bw(bwSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ht(htSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type EIchange(EIchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type NAchange(NAchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type PAL(PALSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb_base(pcarb_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb(pcarbSEXP);
+    Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_EI(input_EISEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input_fat(input_fatSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type target(targetSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    rcpp_result_gen = Rcpp::wrap(adult_weight_target_wrapper(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb_base, pcarb, dt, input_EI, input_fat, days, checkValues, threads, target, knots, solver));
     return rcpp_result_gen;
 END_RCPP
 }
 // child_weight_wrapper
-List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, double referenceValues);
-RcppExport SEXP _bw_child_weight_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP input_EIntakeSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP) {
+List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, double referenceValues, int threads, List knots, List solver, List storage, List checkpoints);
+RcppExport SEXP _bw_child_weight_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP input_EIntakeSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP, SEXP threadsSEXP, SEXP knotsSEXP, SEXP solverSEXP, SEXP storageSEXP, SEXP checkpointsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -91,13 +164,18 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
     Rcpp::traits::input_parameter< double >::type referenceValues(referenceValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper(age, sex, bmiCat, FFM, FM, input_EIntake, days, dt, checkValues, referenceValues));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type storage(storageSEXP);
+    Rcpp::traits::input_parameter< List >::type checkpoints(checkpointsSEXP);
+    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper(age, sex, bmiCat, FFM, FM, input_EIntake, days, dt, checkValues, referenceValues, threads, knots, solver, storage, checkpoints));
     return rcpp_result_gen;
 END_RCPP
 }
 // child_weight_wrapper_richardson
-List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, double referenceValues);
-RcppExport SEXP _bw_child_weight_wrapper_richardson(SEXP ageSEXP, SEXP sexSEXP,  SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP KSEXP, SEXP QSEXP, SEXP ASEXP, SEXP BSEXP, SEXP nuSEXP, SEXP CSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP) {
+List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, double referenceValues, int threads, List solver, List storage, List checkpoints);
+RcppExport SEXP _bw_child_weight_wrapper_richardson(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP KSEXP, SEXP QSEXP, SEXP ASEXP, SEXP BSEXP, SEXP nuSEXP, SEXP CSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP, SEXP threadsSEXP, SEXP solverSEXP, SEXP storageSEXP, SEXP checkpointsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -116,7 +194,11 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
     Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
     Rcpp::traits::input_parameter< double >::type referenceValues(referenceValuesSEXP);
-    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper_richardson(age, sex, bmiCat, FFM, FM, K, Q, A, B, nu, C, days, dt, checkValues, referenceValues));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type storage(storageSEXP);
+    Rcpp::traits::input_parameter< List >::type checkpoints(checkpointsSEXP);
+    rcpp_result_gen = Rcpp::wrap(child_weight_wrapper_richardson(age, sex, bmiCat, FFM, FM, K, Q, A, B, nu, C, days, dt, checkValues, referenceValues, threads, solver, storage, checkpoints));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -133,14 +215,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< NumericVector >::type FM(FMSEXP);
     Rcpp::traits::input_parameter< double >::type days(daysSEXP);
     Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
-    Rcpp::traits::input_parameter< double >::type  referenceValues(referenceValuesSEXP);
+    Rcpp::traits::input_parameter< double >::type referenceValues(referenceValuesSEXP);
     rcpp_result_gen = Rcpp::wrap(intake_reference_wrapper(age, sex, bmiCat, FFM, FM, days, dt, referenceValues));
     return rcpp_result_gen;
 END_RCPP
 }
 // mass_reference_wrapper
 List mass_reference_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, double referenceValues);
-RcppExport SEXP _bw_mass_reference_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP  referenceValuesSEXP) {
+RcppExport SEXP _bw_mass_reference_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP referenceValuesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -152,29 +234,181 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// cohort_cells_wrapper
+List cohort_cells_wrapper(int nind, List rows, List columns);
+RcppExport SEXP _bw_cohort_cells_wrapper(SEXP nindSEXP, SEXP rowsSEXP, SEXP columnsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type nind(nindSEXP);
+    Rcpp::traits::input_parameter< List >::type rows(rowsSEXP);
+    Rcpp::traits::input_parameter< List >::type columns(columnsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cohort_cells_wrapper(nind, rows, columns));
+    return rcpp_result_gen;
+END_RCPP
+}
 // EnergyBuilder
-NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, std::string interpol);
-RcppExport SEXP _bw_EnergyBuilder(SEXP EnergySEXP, SEXP TimeSEXP, SEXP interpolSEXP) {
+NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, std::string interpol, int threads, double seed);
+RcppExport SEXP _bw_EnergyBuilder(SEXP EnergySEXP, SEXP TimeSEXP, SEXP interpolSEXP, SEXP threadsSEXP, SEXP seedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< NumericMatrix >::type Energy(EnergySEXP);
     Rcpp::traits::input_parameter< NumericVector >::type Time(TimeSEXP);
     Rcpp::traits::input_parameter< std::string >::type interpol(interpolSEXP);
-    rcpp_result_gen = Rcpp::wrap(EnergyBuilder(Energy, Time, interpol));
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(EnergyBuilder(Energy, Time, interpol, threads, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// lifecourse_weight_wrapper
+List lifecourse_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, NumericVector ht, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double transition, double days, double dt, bool checkValues, double referenceValues, int threads, List knots, List solver, List output);
+RcppExport SEXP _bw_lifecourse_weight_wrapper(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP input_EIntakeSEXP, SEXP htSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP transitionSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP, SEXP threadsSEXP, SEXP knotsSEXP, SEXP solverSEXP, SEXP outputSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type bmiCat(bmiCatSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FFM(FFMSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FM(FMSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type input_EIntake(input_EIntakeSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ht(htSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type EIchange(EIchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type NAchange(NAchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type PAL(PALSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb_base(pcarb_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb(pcarbSEXP);
+    Rcpp::traits::input_parameter< double >::type transition(transitionSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
+    Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
+    Rcpp::traits::input_parameter< double >::type referenceValues(referenceValuesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type knots(knotsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    rcpp_result_gen = Rcpp::wrap(lifecourse_weight_wrapper(age, sex, bmiCat, FFM, FM, input_EIntake, ht, EIchange, NAchange, PAL, pcarb_base, pcarb, transition, days, dt, checkValues, referenceValues, threads, knots, solver, output));
+    return rcpp_result_gen;
+END_RCPP
+}
+// lifecourse_weight_wrapper_richardson
+List lifecourse_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, NumericVector ht, NumericMatrix EIchange, NumericMatrix NAchange, NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb, double transition, double days, double dt, bool checkValues, double referenceValues, int threads, List solver, List output);
+RcppExport SEXP _bw_lifecourse_weight_wrapper_richardson(SEXP ageSEXP, SEXP sexSEXP, SEXP bmiCatSEXP, SEXP FFMSEXP, SEXP FMSEXP, SEXP KSEXP, SEXP QSEXP, SEXP ASEXP, SEXP BSEXP, SEXP nuSEXP, SEXP CSEXP, SEXP htSEXP, SEXP EIchangeSEXP, SEXP NAchangeSEXP, SEXP PALSEXP, SEXP pcarb_baseSEXP, SEXP pcarbSEXP, SEXP transitionSEXP, SEXP daysSEXP, SEXP dtSEXP, SEXP checkValuesSEXP, SEXP referenceValuesSEXP, SEXP threadsSEXP, SEXP solverSEXP, SEXP outputSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type age(ageSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type sex(sexSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type bmiCat(bmiCatSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FFM(FFMSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type FM(FMSEXP);
+    Rcpp::traits::input_parameter< double >::type K(KSEXP);
+    Rcpp::traits::input_parameter< double >::type Q(QSEXP);
+    Rcpp::traits::input_parameter< double >::type A(ASEXP);
+    Rcpp::traits::input_parameter< double >::type B(BSEXP);
+    Rcpp::traits::input_parameter< double >::type nu(nuSEXP);
+    Rcpp::traits::input_parameter< double >::type C(CSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ht(htSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type EIchange(EIchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type NAchange(NAchangeSEXP);
+    Rcpp::traits::input_parameter< NumericMatrix >::type PAL(PALSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb_base(pcarb_baseSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type pcarb(pcarbSEXP);
+    Rcpp::traits::input_parameter< double >::type transition(transitionSEXP);
+    Rcpp::traits::input_parameter< double >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< double >::type dt(dtSEXP);
+    Rcpp::traits::input_parameter< bool >::type checkValues(checkValuesSEXP);
+    Rcpp::traits::input_parameter< double >::type referenceValues(referenceValuesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< List >::type solver(solverSEXP);
+    Rcpp::traits::input_parameter< List >::type output(outputSEXP);
+    rcpp_result_gen = Rcpp::wrap(lifecourse_weight_wrapper_richardson(age, sex, bmiCat, FFM, FM, K, Q, A, B, nu, C, ht, EIchange, NAchange, PAL, pcarb_base, pcarb, transition, days, dt, checkValues, referenceValues, threads, solver, output));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compact_decode_wrapper
+NumericVector compact_decode_wrapper(List compact, NumericVector index);
+RcppExport SEXP _bw_compact_decode_wrapper(SEXP compactSEXP, SEXP indexSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type compact(compactSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type index(indexSEXP);
+    rcpp_result_gen = Rcpp::wrap(compact_decode_wrapper(compact, index));
+    return rcpp_result_gen;
+END_RCPP
+}
+// population_sums_wrapper
+NumericVector population_sums_wrapper(List model, std::vector<std::string> vars, IntegerVector group, IntegerVector strata, NumericVector weights, int ngroups, int nstrata, int threads);
+RcppExport SEXP _bw_population_sums_wrapper(SEXP modelSEXP, SEXP varsSEXP, SEXP groupSEXP, SEXP strataSEXP, SEXP weightsSEXP, SEXP ngroupsSEXP, SEXP nstrataSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type vars(varsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type strata(strataSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< int >::type ngroups(ngroupsSEXP);
+    Rcpp::traits::input_parameter< int >::type nstrata(nstrataSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(population_sums_wrapper(model, vars, group, strata, weights, ngroups, nstrata, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// population_summary_wrapper
+List population_summary_wrapper(NumericVector sums, NumericVector stratum_n, std::vector<std::string> vars, NumericVector time);
+RcppExport SEXP _bw_population_summary_wrapper(SEXP sumsSEXP, SEXP stratum_nSEXP, SEXP varsSEXP, SEXP timeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type sums(sumsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type stratum_n(stratum_nSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type vars(varsSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type time(timeSEXP);
+    rcpp_result_gen = Rcpp::wrap(population_summary_wrapper(sums, stratum_n, vars, time));
+    return rcpp_result_gen;
+END_RCPP
+}
+// survey_mean_wrapper
+List survey_mean_wrapper(List model, std::vector<std::string> vars, IntegerVector days, IntegerVector group, NumericVector weights, IntegerVector strata, IntegerVector psu, int threads);
+RcppExport SEXP _bw_survey_mean_wrapper(SEXP modelSEXP, SEXP varsSEXP, SEXP daysSEXP, SEXP groupSEXP, SEXP weightsSEXP, SEXP strataSEXP, SEXP psuSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type vars(varsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type days(daysSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type group(groupSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type weights(weightsSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type strata(strataSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type psu(psuSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(survey_mean_wrapper(model, vars, days, group, weights, strata, psu, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_bw_adult_weight_wrapper", (DL_FUNC) &_bw_adult_weight_wrapper, 12},
-    {"_bw_adult_weight_wrapper_EI", (DL_FUNC) &_bw_adult_weight_wrapper_EI, 14},
-    {"_bw_adult_weight_wrapper_EI_fat", (DL_FUNC) &_bw_adult_weight_wrapper_EI_fat, 14},
-    {"_bw_child_weight_wrapper", (DL_FUNC) &_bw_child_weight_wrapper, 10},
-    {"_bw_child_weight_wrapper_richardson", (DL_FUNC) &_bw_child_weight_wrapper_richardson, 15},
+    {"_bw_adult_weight_wrapper", (DL_FUNC) &_bw_adult_weight_wrapper, 17},
+    {"_bw_adult_weight_wrapper_EI", (DL_FUNC) &_bw_adult_weight_wrapper_EI, 19},
+    {"_bw_adult_weight_wrapper_EI_fat", (DL_FUNC) &_bw_adult_weight_wrapper_EI_fat, 19},
+    {"_bw_adult_weight_scenarios_wrapper", (DL_FUNC) &_bw_adult_weight_scenarios_wrapper, 20},
+    {"_bw_adult_weight_target_wrapper", (DL_FUNC) &_bw_adult_weight_target_wrapper, 18},
+    {"_bw_child_weight_wrapper", (DL_FUNC) &_bw_child_weight_wrapper, 15},
+    {"_bw_child_weight_wrapper_richardson", (DL_FUNC) &_bw_child_weight_wrapper_richardson, 19},
     {"_bw_intake_reference_wrapper", (DL_FUNC) &_bw_intake_reference_wrapper, 8},
     {"_bw_mass_reference_wrapper", (DL_FUNC) &_bw_mass_reference_wrapper, 4},
-    {"_bw_EnergyBuilder", (DL_FUNC) &_bw_EnergyBuilder, 3},
+    {"_bw_cohort_cells_wrapper", (DL_FUNC) &_bw_cohort_cells_wrapper, 3},
+    {"_bw_EnergyBuilder", (DL_FUNC) &_bw_EnergyBuilder, 5},
+    {"_bw_lifecourse_weight_wrapper", (DL_FUNC) &_bw_lifecourse_weight_wrapper, 21},
+    {"_bw_lifecourse_weight_wrapper_richardson", (DL_FUNC) &_bw_lifecourse_weight_wrapper_richardson, 25},
+    {"_bw_compact_decode_wrapper", (DL_FUNC) &_bw_compact_decode_wrapper, 2},
+    {"_bw_population_sums_wrapper", (DL_FUNC) &_bw_population_sums_wrapper, 8},
+    {"_bw_population_summary_wrapper", (DL_FUNC) &_bw_population_summary_wrapper, 4},
+    {"_bw_survey_mean_wrapper", (DL_FUNC) &_bw_survey_mean_wrapper, 8},
     {NULL, NULL, 0}
 };
 
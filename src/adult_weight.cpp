@@ -10,9 +10,11 @@
 //  ht              .-  Height (m).
 //  age             .-  Years since individual first arrived to Earth.
 //  sex             .-  Either 1 = "female" or 0 = "male".
-//  EIchange        .-  Change in energy intake (kcal).
-//  NAchange        .-  Change in sodium consumption (mg).
-//  PAL             .-  Physical activity level. (Between 1.4 and 2.4)
+//  EIchange        .-  Change in energy intake (kcal). Matrix of nind x days.
+//  NAchange        .-  Change in sodium consumption (mg). Matrix of nind x days.
+//  PAL             .-  Physical activity level. (Between 1.4 and 2.4) Matrix of nind x days.
+//                      Any of the three may have a single row (shared by every individual)
+//                      or a single column (the same every day); see InputView.
 //  pcarb           .-  Proportion of carbohydrates from diet throughout the time the model runs.
 //  pcarb_baseline  .-  Proportion of carbohydrates from diet at baseline.
 //  dt              .-  Time step used to solve the ODE system numerically.
@@ -62,7 +64,46 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //----------------------------------------------------------------------------------------
 
+#include <cmath>
+#include <limits>
 #include "adult_weight.h"
+#include "vector_math.h"
+#include "dual_number.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Individuals integrated together by a thread in the fused engine
+static const int chunk_size = 256;
+
+//Variables that the fused engine can return. BMI_Category is stored as the
+//codes of BMICode and labelled once integration is over; its indicators are
+//only used for the prevalence (summary = "mean")
+enum AdultVariable {OUT_AGE, OUT_AT, OUT_ECF, OUT_GLY, OUT_FAT, OUT_LEAN, OUT_BW,
+                    OUT_BMI, OUT_TEI, OUT_UNDERWEIGHT, OUT_NORMAL, OUT_PREOBESE,
+                    OUT_OBESE, OUT_CATEGORY};
+static const int nadult_variables = OUT_CATEGORY + 1;
+static const char *adult_variables[] = {"Age", "Adaptive_Thermogenesis",
+    "Extracellular_Fluid", "Glycogen", "Fat_Mass", "Lean_Mass", "Body_Weight",
+    "Body_Mass_Index", "Energy_Intake", "BMI_Category_Underweight",
+    "BMI_Category_Normal", "BMI_Category_Pre-Obese", "BMI_Category_Obese",
+    "BMI_Category"};
+
+//Parameters whose sensitivities (derivatives of the body weight) the fused
+//engine can return. PAL and pcarb are shifts of the inputs of every time step.
+enum AdultParameter {SENS_BETAAT, SENS_TAUAT, SENS_BETATEF, SENS_GAMMAF, SENS_GAMMAL,
+                     SENS_ETAF, SENS_ETAL, SENS_PAL, SENS_PCARB};
+static const int nadult_parameters = SENS_PCARB + 1;
+static const char *adult_parameters[] = {"betaAT", "tauAT", "betaTEF", "gammaF", "gammaL",
+    "etaF", "etaL", "PAL", "pcarb"};
+
+//The state of an individual is valid while AT is finite and ECF, G and L are
+//positive and finite (the bounds checked by vflag in integrateFused)
+static inline bool validState(double AT, double ECF, double G, double L){
+    return std::isfinite(AT) && std::isfinite(ECF) && std::isfinite(G) && std::isfinite(L) &&
+           ECF > 0 && G > 0 && L > 0;
+}
 
 //Default Constructor for an Adult.
 Adult::Adult(NumericVector weight, NumericVector height, NumericVector age_yrs,
@@ -125,6 +166,7 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     
     //Get energy
     getParameters();
+    getInputs();
     getRMR();
     getATinit();
     getECFinit();
@@ -134,6 +176,7 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
    // getDelta(); //Check
     getK();
     getCarbConstants();
+    getBuffers();
 }
 
 //Function to build a new Adult when input_EIintake and fat are included
@@ -158,13 +201,15 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     
     //Get additional information
     getParameters();
+    getInputs();
     getRMR();
     getATinit();
     getECFinit();
     
     if (isEnergy){
         //Get energy
-        EI     = extradata;
+        EI          = extradata;
+        estimatedEI = false;
         
         //Get bw
         getBaselineMass();
@@ -181,6 +226,7 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     //getDelta();
     getK();
     getCarbConstants();
+    getBuffers();
 }
 
 //Function to build a new Adult when input_EIintake is included
@@ -205,18 +251,21 @@ void Adult::build(NumericVector weight, NumericVector height, NumericVector age_
     
     //Get additional information
     getParameters();
+    getInputs();
     getRMR();
     getATinit();
     getECFinit();
     
     //Inputted ei and fat
-    EI     = input_EI;
+    EI          = input_EI;
+    estimatedEI = false;
     fat    = input_fat;
     lean    = bw - (ecfinit + fat + 3.7*G_base);
 
     //getDelta();
     getK();
     getCarbConstants();
+    getBuffers();
 }
 
 //Destroyer
@@ -224,10 +273,15 @@ Adult::~Adult(void){
     
 }
 
+std::vector<std::string> Adult::variables(void){
+    return std::vector<std::string>(adult_variables, adult_variables + nadult_variables);
+}
+
 void Adult::getParameters(void){
     
     //Get size of model
     nind    = bw.size();
+    ht2     = ht*ht;
     
     //Set to true
     
@@ -254,6 +308,37 @@ void Adult::getParameters(void){
     rmr_m  = 5.0;         //Linear regression coefficient for rmr estimation (men)
     rmr_f  = 161.0;       //Linear regression coefficient for rmr estimation (women)
     G_base = NumericVector(nind, 0.5);
+    
+    //The same parameters for the right-hand sides of the fused engine (which
+    //may also carry their derivatives, see sensitivity)
+    parameters.betaAT  = betaAT;
+    parameters.tauAT   = tauAT;
+    parameters.betaTEF = betaTEF;
+    parameters.gammaF  = gammaF;
+    parameters.gammaL  = gammaL;
+    parameters.alfa1   = alfa1;
+    parameters.alfa2   = alfa2;
+    
+    //EI is the steady state of the baseline unless given by the constructor
+    estimatedEI = true;
+    
+    //Fixed step RK4 unless setSolver says otherwise
+    adaptive  = false;
+    tolerance = 1e-6;
+    steady    = 0.0;
+    halt      = false;
+    nscen     = 1;
+    
+    //Integration starts at baseline unless setCheckpoints resumes a run
+    step0     = 0;
+    
+    //Every individual is integrated with its own EIchange (see target)
+    shift_ptr = NULL;
+    skip_ptr  = NULL;
+    
+    //Every individual starts at step 0 (see Lifecourse)
+    start_ptr  = NULL;
+    origin_ptr = NULL;
 }
 
 //Estimation of Resting Metabolic Rate (rmr) in kcal
@@ -268,7 +353,7 @@ void Adult::getRMR(void){
 void Adult::getCaloricSteadyState(void){
     //These estimation assumes Energy Intake = Energy Expenditure.
     //Energy is returned in kcal
-    steadystate = rmr*PAL(0,_);  //Check when running for the first tiem it might me PAL(_,0)
+    steadystate = rmr*PALview.values(0, nind);  //PAL of the first day
 }
 
 void Adult::getATinit(void){
@@ -302,8 +387,8 @@ void Adult::getECFinit(void){
 //Estimation of initial fat and lean masses
 void Adult::getBaselineMass(void){
     
-    fat =  (bw * (0.14 * age + 37.31 * log(bw/( pow (ht,2.0))) - 103.94)/100.0)*(1-sex) +
-    (bw * (0.14 * age + 39.96 * log(bw/( pow (ht,2.0))) - 102.01)/100.0)*sex;
+    fat =  (bw * (0.14 * age + 37.31 * log(bw/ht2) - 103.94)/100.0)*(1-sex) +
+    (bw * (0.14 * age + 39.96 * log(bw/ht2) - 102.01)/100.0)*sex;
     
     
     //Get lean mass:
@@ -338,6 +423,177 @@ void Adult::getCarbConstants(void){
     kG  = CIb/( pow (G_base, 2.0) );
 }
 
+//Raw pointers to the model vectors for the fused engine
+void Adult::getBuffers(void){
+    bw_ptr       = bw.begin();
+    ht_ptr       = ht.begin();
+    ht2_ptr      = ht2.begin();
+    age_ptr      = age.begin();
+    sex_ptr      = sex.begin();
+    EI_ptr       = EI.begin();
+    fat_ptr      = fat.begin();
+    lean_ptr     = lean.begin();
+    ecfinit_ptr  = ecfinit.begin();
+    atinit_ptr   = atinit.begin();
+    G_base_ptr   = G_base.begin();
+    CIb_ptr      = CIb.begin();
+    pcarb_ptr    = pcarb.begin();
+    kG_ptr       = kG.begin();
+    K_ptr        = K.begin();
+    rmr_ptr      = rmr.begin();
+    pcarb_base_ptr = pcarb_base.begin();
+}
+
+//Views of the intake changes and physical activity. Each one is read as an
+//nind x days matrix without being expanded: a single row is shared by every
+//individual and a single column is the same at every time step (so constant
+//inputs are never materialised). Matrices replaced by knots do not bound the
+//time steps of the run.
+void Adult::getInputs(void){
+    EIview      = InputView(EIchange, true);
+    NAview      = InputView(NAchange, true);
+    PALview     = InputView(PAL, true);
+    nstep_input = ::inputSteps(EIknots.active ? InputView() : EIview,
+                               NAknots.active ? InputView() : NAview, PALview);
+}
+
+//Time steps of a run of days: the last stage of RK4 uses the inputs of the next
+//step so the run has one step less than its inputs, which are taken as having
+//ceil(days/dt) columns when none of them changes over time
+double Adult::inputSteps(double days){
+    const double steps = ceil(days/dt);
+    return std::min(steps, (nstep_input > 0 ? nstep_input : steps) - 1.0);
+}
+
+//Scenarios of the intake changes and physical activity sharing the baseline of
+//each individual (which is only computed once). Scenario s of individual j is
+//integrated as individual j*nscenarios + s so the scenarios of an individual are
+//contiguous; input_EIchange, input_NAchange and physicalactivity are
+//(nind x nscenarios) x days matrices in that order (EIchange and NAchange may be
+//replaced by knots with setKnots). rk4_fused then returns each variable with a
+//trailing scenario dimension.
+void Adult::setScenarios(int nscenarios, NumericMatrix input_EIchange,
+                         NumericMatrix input_NAchange, NumericMatrix physicalactivity){
+    if (nscenarios < 1 || physicalactivity.nrow() != nind*nscenarios){
+        stop("Dimension mismatch. Scenarios must have one row per individual and scenario.");
+    }
+    
+    //Baseline of every individual repeated for each of its scenarios
+    bw          = rep_each(bw, nscenarios);
+    ht          = rep_each(ht, nscenarios);
+    ht2         = rep_each(ht2, nscenarios);
+    age         = rep_each(age, nscenarios);
+    sex         = rep_each(sex, nscenarios);
+    EI          = rep_each(EI, nscenarios);
+    fat         = rep_each(fat, nscenarios);
+    lean        = rep_each(lean, nscenarios);
+    steadystate = rep_each(steadystate, nscenarios);
+    G_base      = rep_each(G_base, nscenarios);
+    ecfinit     = rep_each(ecfinit, nscenarios);
+    CIb         = rep_each(CIb, nscenarios);
+    pcarb       = rep_each(pcarb, nscenarios);
+    pcarb_base  = rep_each(pcarb_base, nscenarios);
+    kG          = rep_each(kG, nscenarios);
+    K           = rep_each(K, nscenarios);
+    rmr         = rep_each(rmr, nscenarios);
+    atinit      = rep_each(atinit, nscenarios);
+    
+    EIchange    = input_EIchange;
+    NAchange    = input_NAchange;
+    PAL         = physicalactivity;
+    nind        = nind*nscenarios;
+    nscen       = nscenarios;
+    getInputs();
+    getBuffers();
+}
+
+//Integration method of rk4_fused. solver is a list with the method ("RK4" or
+//"RK45"), the tolerance of the adaptive method and steady. With RK4 and steady > 0
+//individuals whose inputs no longer change leave the RK4 loop once AT, ECF and
+//G change less than steady per day; the rest of their run is given by the
+//adaptive method. With halt = TRUE (and checkValues) individuals whose state is
+//invalid are no longer integrated and report NA from then on.
+void Adult::setSolver(List solver){
+    adaptive  = as<std::string>(solver["method"]) == "RK45";
+    tolerance = as<double>(solver["tolerance"]);
+    if (solver.containsElementNamed("steady")){
+        steady = as<double>(solver["steady"]);
+    }
+    if (solver.containsElementNamed("halt")){
+        halt = as<bool>(solver["halt"]);
+    }
+}
+
+//Knots of the intake changes. knots is a list with elements EIchange and (or)
+//NAchange, each one a list with the energy, time and interpolation of
+//energy_build. Day i + 1 of the knots is used for time step i of the matrix it
+//replaces (energy_build drops day 0) so results are the same as running the
+//model with the matrix built by energy_build.
+void Adult::setKnots(List knots){
+    if (knots.containsElementNamed("EIchange")){
+        EIknots = EnergyKnots(as<List>(knots["EIchange"]));
+    }
+    if (knots.containsElementNamed("NAchange")){
+        NAknots = EnergyKnots(as<List>(knots["NAchange"]));
+    }
+    getInputs();
+}
+
+//Checkpoints of rk4_fused. checkpoints is a list with the time steps (steps) at
+//which the state of every individual is saved and optionally a checkpoint
+//(resume) returned by a previous run of the same individuals to start from. A
+//checkpoint has the time step and time at which it was taken, dt, the state
+//(AT, ECF, G, L and age) and every constant of the individuals computed at
+//baseline (which replace those of the constructor). Inputs are still indexed by
+//the time step since baseline, so a run resumed with inputs that extend those
+//of the previous run gives exactly the same values as an uninterrupted run.
+void Adult::setCheckpoints(List checkpoints){
+    
+    checkpoint_steps = as< std::vector<int> >(checkpoints["steps"]);
+    if (!checkpoints.containsElementNamed("resume")){
+        return;
+    }
+    
+    List resume    = as<List>(checkpoints["resume"]);
+    List state     = as<List>(resume["state"]);
+    List constants = as<List>(resume["constants"]);
+    if (as<std::string>(resume["Model_Type"]) != "Adult" || as<double>(resume["dt"]) != dt ||
+        as<NumericVector>(constants["bw"]).size() != nind){
+        stop("Invalid resume. The checkpoint must come from a run of the same adults with the same dt.");
+    }
+    
+    //Constants of the run that saved the checkpoint
+    bw          = as<NumericVector>(constants["bw"]);
+    ht          = as<NumericVector>(constants["ht"]);
+    ht2         = as<NumericVector>(constants["ht2"]);
+    age         = as<NumericVector>(constants["age"]);
+    sex         = as<NumericVector>(constants["sex"]);
+    EI          = as<NumericVector>(constants["EI"]);
+    fat         = as<NumericVector>(constants["fat"]);
+    lean        = as<NumericVector>(constants["lean"]);
+    steadystate = as<NumericVector>(constants["steadystate"]);
+    G_base      = as<NumericVector>(constants["G_base"]);
+    ecfinit     = as<NumericVector>(constants["ecfinit"]);
+    CIb         = as<NumericVector>(constants["CIb"]);
+    pcarb       = as<NumericVector>(constants["pcarb"]);
+    pcarb_base  = as<NumericVector>(constants["pcarb_base"]);
+    kG          = as<NumericVector>(constants["kG"]);
+    K           = as<NumericVector>(constants["K"]);
+    rmr         = as<NumericVector>(constants["rmr"]);
+    atinit      = as<NumericVector>(constants["atinit"]);
+    getBuffers();
+    
+    //State at the time step of the checkpoint
+    step0 = as<int>(resume["step"]);
+    state0.clear();
+    const char *names[] = {"Adaptive_Thermogenesis", "Extracellular_Fluid", "Glycogen",
+                           "Lean_Mass", "Age"};
+    for (int v = 0; v < 5; v++){
+        NumericVector x = as<NumericVector>(state[names[v]]);
+        state0.insert(state0.end(), x.begin(), x.end());
+    }
+}
+
 
 //Carbohydrate intake
 NumericVector Adult::CI(double t){
@@ -358,7 +614,12 @@ void Adult::getK(){
      RMR is from the Mifflin-St Jeor equation. The physical activity pa- rameter, delta, at the baseline
      steady state is determined by equation 8 and therefore you can solve for K.
      */
-    K = (rmr * PAL(0,_)) - gammaL * lean - gammaF * fat - ((1.0 - betaTEF)*PAL(0,_) - 1.0)*rmr/bw * bw; //AQUI! Check when running for the first tiem it might me PAL(_,0)
+    getK(PALview.values(0, nind)); //PAL of the first day
+}
+
+//K with the physical activity PAL_base of each individual at its baseline
+void Adult::getK(NumericVector PAL_base){
+    K = (rmr * PAL_base) - gammaL * lean - gammaF * fat - ((1.0 - betaTEF)*PAL_base - 1.0)*rmr/bw * bw;
 }
 
 //Get fat mass as function of lean tissue
@@ -381,6 +642,29 @@ NumericVector Adult::R(double t, NumericVector L, NumericVector G,
     return (R3 + gammaL*L + gammaF*F)/(alfa1 + alfa2*F);
 }
 
+//Integer code of the BMI category: 1 = Underweight, 2 = Normal, 3 = Pre-Obese,
+//4 = Obese and NA if unknown (same cutoffs as BMIClassifier)
+int Adult::BMICode(double BMI){
+    if (BMI < 18.5){
+        return 1;
+    } else if (BMI >= 18.5 && BMI < 25){
+        return 2;
+    } else if (BMI >= 25 && BMI < 30){
+        return 3;
+    } else if (BMI >= 30){
+        return 4;
+    }
+    return NA_INTEGER;
+}
+
+IntegerVector Adult::BMICode(NumericVector BMI){
+    IntegerVector classification(BMI.size());
+    for(int i = 0; i < BMI.size(); i++){
+        classification(i) = BMICode(BMI(i));
+    }
+    return classification;
+}
+
 //Classifier for bMI
 StringVector Adult::BMIClassifier(NumericVector BMI){
     StringVector classification(BMI.size());
@@ -419,6 +703,19 @@ StringVector Adult::BMIClassifier(NumericVector BMI){
     return classification;
 }
 
+//Labels of the codes of BMICode
+StringVector Adult::BMILabel(IntegerVector code){
+    const char *labels[] = {"Underweight", "Normal", "Pre-Obese", "Obese"};
+    StringVector classification(code.size());
+    for(int i = 0; i < code.size(); i++){
+        classification(i) = "Unknown";
+        if (code(i) >= 1 && code(i) <= 4){
+            classification(i) = labels[code(i) - 1];
+        }
+    }
+    return classification;
+}
+
 
 //Rungue Kutta 4 method for Adult
 List Adult::rk4(double days){
@@ -427,7 +724,7 @@ List Adult::rk4(double days){
     NumericVector k1, k2, k3, k4;
     
     //Estimate number of elements to loop into
-    const int nsims = std::min(ceil(days/dt), EIchange.nrow() - 1.0);
+    const int nsims = inputSteps(days);
     
     NumericMatrix AT(nind, nsims + 1); //in rcpp
     NumericMatrix ECF(nind, nsims + 1); //in rcpp
@@ -449,7 +746,7 @@ List Adult::rk4(double days){
     L(_,0)   = lean;
     F(_,0)   = fatMass(lean);
     BW(_,0)  = bw;
-    BMI(_,0) = bw/pow(ht,2.0);
+    BMI(_,0) = bw/ht2;
     CAT(_,0) = BMIClassifier(BMI(_,0));
     TEI(_,0) = EI;
     TIME(0)  = 0.0;
@@ -506,7 +803,7 @@ List Adult::rk4(double days){
         BW(_,i) = F(_,i) + L(_,i) + ECF(_,i) + 3.7*GLY(_,i);
         
         //Update BMI
-        BMI(_,i) = BW(_,i)/pow(ht,2.0);
+        BMI(_,i) = BW(_,i)/ht2;
         
         //Classify BMI
         CAT(_,i) = BMIClassifier(BMI(_,i));
@@ -542,17 +839,1172 @@ List Adult::rk4(double days){
 
 //Change in calories
 NumericVector Adult::deltaEI(double t){
-    return EIchange(floor(t/dt),_);
+    NumericVector change(nind);
+    for (int j = 0; j < nind; j++){
+        change(j) = deltaEI(t, j);
+    }
+    return change;
 }
 
 //Change in sodiumxs
 NumericVector Adult::deltaNA(double t){
-    return NAchange(floor(t/dt),_);
+    NumericVector change(nind);
+    for (int j = 0; j < nind; j++){
+        change(j) = deltaNA(t, j);
+    }
+    return change;
 }
 
 
 //Change in sodiumxs
 NumericVector Adult::deltaPAL(double t){
-    return PAL(floor(t/dt),_);
+    return PALview.values(floor(t/dt), nind);
 }  // Check
 
+
+
+//Scalar functions for the fused engine
+//----------------------------------------------------------------------------------------
+//Each one evaluates the same expression as its NumericVector counterpart above (up to
+//the vexp tolerance of the exponentials of a stage) but for a single individual j so
+//that no temporary vectors are created. Inputs that do not depend on the state are
+//taken from the AdultDrivers of the stage time.
+
+//Change in calories (EIchange is nind x days so the individuals of one time step
+//are contiguous)
+double Adult::deltaEI(double t, int j){
+    return EIrow(floor(t/dt), j);
+}
+
+//Change in sodium
+double Adult::deltaNA(double t, int j){
+    return NArow(floor(t/dt), j);
+}
+
+//Physical activity
+double Adult::deltaPAL(double t, int j){
+    return PALrow(floor(t/dt), j);
+}
+
+//Inputs of individual j at time step row
+double Adult::EIrow(int row, int j){
+    const double change = EIknots.active ? EIknots.value(row + 1, j) : EIview.value(row, j);
+    return shift_ptr ? change + shift_ptr[j] : change;
+}
+
+double Adult::NArow(int row, int j){
+    if (NAknots.active){
+        return NAknots.value(row + 1, j);
+    }
+    return NAview.value(row, j);
+}
+
+double Adult::PALrow(int row, int j){
+    return PALview.value(row, j);
+}
+
+//Exponent of fatMass (the fused engine takes the exponentials of a whole stage
+//together with vexp)
+template <typename T>
+T Adult::fatExponent(const T &L, int j){
+    return roL * (L - lean_ptr[j])/(roF * C);
+}
+
+//Fat mass as function of lean tissue
+template <typename T>
+T Adult::fatMass(const T &L, int j){
+    return fat_ptr[j] * exp(fatExponent(L, j));
+}
+
+//Exogenous drivers of individual j at time t (TotalIntake, CI and the terms of
+//delta_times_bw that do not depend on the state)
+void Adult::drivers(double t, int j, AdultDrivers &d){
+    drivers((int) floor(t/dt), t, j, d);
+}
+
+//Same with the inputs of time step row
+void Adult::drivers(int row, double t, int j, AdultDrivers &d){
+    const AdultBaseline<double> b = {EI_ptr[j], pcarb_ptr[j], 0.0, K_ptr[j], CIb_ptr[j], kG_ptr[j]};
+    drivers(row, t, j, b, parameters, d);
+}
+
+//Same with the constants b of the individual and the parameters p
+template <typename T>
+void Adult::drivers(int row, double t, int j, const AdultBaseline<T> &b,
+                    const AdultParameters<T> &p, AdultDriversOf<T> &d){
+    d.dEI    = EIrow(row, j);
+    d.dNA    = NArow(row, j);
+    d.TI     = b.EI + d.dEI;
+    d.CI     = b.pcarb * d.TI;
+    d.coef   = ((1 - p.betaTEF)*(PALrow(row, j) + b.PAL) - 1);
+    d.ht625  = 625*ht_ptr[j];
+    d.age492 = 4.92*(age_ptr[j] + (origin_ptr ? t - origin_ptr[j] : t)/365);
+    d.sex166 = 166*sex_ptr[j];
+    d.K      = b.K;
+    d.CIb    = b.CIb;
+    d.kG     = b.kG;
+}
+
+//R helper for Lean derivative
+double Adult::R(double L, double G, double AT, double ECF, const AdultDrivers &d, int j){
+    return R(L, fatMass(L, j), G, AT, ECF, d, j);
+}
+
+//Same with the fat mass F of L
+double Adult::R(double L, double F, double G, double AT, double ECF, const AdultDrivers &d, int j){
+    return R(L, F, G, AT, ECF, d, parameters);
+}
+
+template <typename T>
+T Adult::R(const T &L, const T &F, const T &G, const T &AT, const T &ECF,
+           const AdultDriversOf<T> &d, const AdultParameters<T> &p){
+    T rmr_t = 9.99*(F + L + 3.7*G + ECF) + d.ht625 - d.age492 +5 - d.sex166;
+    T R3    = d.K + d.coef*rmr_t + p.betaTEF*d.dEI + AT - d.TI + dG(G, d);
+    return (R3 + p.gammaL*L + p.gammaF*F)/(p.alfa1 + p.alfa2*F);
+}
+
+//Adaptive Thermogenesis derivative
+double Adult::dAT(double AT, const AdultDrivers &d){
+    return dAT(AT, d, parameters);
+}
+
+template <typename T>
+T Adult::dAT(const T &AT, const AdultDriversOf<T> &d, const AdultParameters<T> &p){
+    return (p.betaAT *d.dEI - AT)*(1.0 /p.tauAT);
+}
+
+//Extracellular fluid derivative
+template <typename T>
+T Adult::dECF(const T &ECF, const AdultDriversOf<T> &d, int j){
+    return ( d.dNA - zetaNa*(ECF - ecfinit_ptr[j]) - zetaCI*(1.0 - d.CI/d.CIb) )/Na;
+}
+
+//Glycogen
+template <typename T>
+T Adult::dG(const T &G, const AdultDriversOf<T> &d){
+    return (d.CI - d.kG*pow(G, 2.0))/roG;
+}
+
+//Lean tissue derivative
+double Adult::dL(double L, double G, double AT, double ECF, const AdultDrivers &d, int j){
+    return R(L, G, AT, ECF, d, j)*(C/roL);
+}
+
+//Same with the fat mass F of L
+double Adult::dL(double L, double F, double G, double AT, double ECF, const AdultDrivers &d, int j){
+    return dL(L, F, G, AT, ECF, d, parameters);
+}
+
+template <typename T>
+T Adult::dL(const T &L, const T &F, const T &G, const T &AT, const T &ECF,
+            const AdultDriversOf<T> &d, const AdultParameters<T> &p){
+    return R(L, F, G, AT, ECF, d, p)*(C/roL);
+}
+
+//Store the state of individual j at report r (only the variables in out)
+void Adult::record(int r, int j, double AGE, double AT, double ECF, double G, double L,
+                   double F, double BW, double TEI, ModelOutput &out, ModelOutputPartial &part){
+    out.put(OUT_AGE, r, j, AGE, part);
+    out.put(OUT_AT, r, j, AT, part);
+    out.put(OUT_ECF, r, j, ECF, part);
+    out.put(OUT_GLY, r, j, G, part);
+    out.put(OUT_FAT, r, j, F, part);
+    out.put(OUT_LEAN, r, j, L, part);
+    out.put(OUT_BW, r, j, BW, part);
+    out.put(OUT_BMI, r, j, BW/ht2_ptr[j], part);
+    out.put(OUT_TEI, r, j, TEI, part);
+    if (out.wants(OUT_UNDERWEIGHT) || out.wants(OUT_CATEGORY)){
+        const int code = BMICode(BW/ht2_ptr[j]);
+        out.put(OUT_UNDERWEIGHT, r, j, code == 1, part);
+        out.put(OUT_NORMAL, r, j, code == 2, part);
+        out.put(OUT_PREOBESE, r, j, code == 3, part);
+        out.put(OUT_OBESE, r, j, code == 4, part);
+        out.put(OUT_CATEGORY, r, j, code == NA_INTEGER ? NA_REAL : code, part);
+    }
+}
+
+//Fused Rungue Kutta 4 for individuals first, ..., last - 1. The state of the
+//chunk is kept in local buffers and only reported steps are written to out.
+//With check the new state of every step is checked for all the individuals at
+//once (see vflag) and the first invalid step of each one is kept in failed.
+void Adult::integrateFused(int first, int last, int nsims, const double *TIME,
+                           ModelOutput &out, ModelOutputPartial &part){
+    
+    const int n = last - first;
+    std::vector<double> state(5*n);
+    double *AT  = &state[0];
+    double *ECF = AT + n;
+    double *GLY = ECF + n;
+    double *L   = GLY + n;
+    double *AGE = L + n;
+    
+    //Initial states (or those of the checkpoint the run resumes from)
+    const bool resumed = !state0.empty();
+    for (int j = first; j < last; j++){
+        const int k = j - first;
+        AT[k]  = resumed ? state0[j] : atinit_ptr[j];
+        ECF[k] = resumed ? state0[nind + j] : ecfinit_ptr[j];
+        GLY[k] = resumed ? state0[2*nind + j] : G_base_ptr[j];
+        L[k]   = resumed ? state0[3*nind + j] : lean_ptr[j];
+        AGE[k] = resumed ? state0[4*nind + j] : age_ptr[j];
+    }
+    
+    double k1, k2, k3, k4;
+    
+    //Drivers at the start of the step (those at the end of the previous one as
+    //t + dt is the next TIME), in the middle and at the end
+    std::vector<AdultDrivers> start(n), half(n), full(n);
+    for (int j = first; j < last; j++){
+        drivers(TIME[0], j, start[j - first]);
+    }
+    
+    //Values of the step for the a-th active individual: new AT, ECF and G, the
+    //lean tissue and its slope at each RK stage and the exponentials of fatMass
+    //at the lean tissue of the stage (evaluated together by vexp)
+    std::vector<double> work(9*n);
+    double *at_new  = &work[0];
+    double *ecf_new = at_new + n;
+    double *g_new   = ecf_new + n;
+    double *lstage  = g_new + n;
+    double *ex      = lstage + n;
+    double *kL[4]   = {ex + n, ex + 2*n, ex + 3*n, ex + 4*n};
+    static const double stage_c[4] = {0.0, 0.5, 0.5, 1.0};
+    
+    //A resumed run reports the checkpoint as the previous run reported that step
+    //(the baselines of a lifecourse run are reported by the children)
+    if (out.report[0] >= 0 && !start_ptr){
+        if (resumed){
+            for (int k = 0; k < n; k++){
+                ex[k] = fatExponent(L[k], first + k);
+            }
+            vexp(ex, ex, n);
+        }
+        for (int j = first; j < last; j++){
+            const int k = j - first;
+            if (resumed){
+                const double F = fat_ptr[j] * ex[k];
+                record(0, j, AGE[k], AT[k], ECF[k], GLY[k], L[k], F,
+                       F + L[k] + ECF[k] + 3.7*GLY[k], start[k].TI, out, part);
+            } else {
+                record(0, j, AGE[k], AT[k], ECF[k], GLY[k], L[k], fatMass(L[k], j),
+                       bw_ptr[j], EI_ptr[j], out, part);
+            }
+        }
+    }
+    
+    //Invalid baselines fail at their first step
+    std::vector<unsigned char> bad(n, 0);
+    if (check){
+        const double inf = std::numeric_limits<double>::infinity();
+        vflag(AT, -inf, bad.data(), n);
+        vflag(ECF, 0.0, bad.data(), n);
+        vflag(GLY, 0.0, bad.data(), n);
+        vflag(L, 0.0, bad.data(), n);
+        for (int k = 0; k < n; k++){
+            if (bad[k]){
+                failed[first + k] = start_ptr ? start_ptr[first + k] : step0;
+                bad[k]            = 0;
+            }
+        }
+    }
+    
+    //Individuals still integrated (in order, without those skipped by target),
+    //those at steady state with the time step at which they were frozen and
+    //those halted with the step of their invalid state (see setSolver)
+    std::vector<int> active(n), frozen, ifrozen, halted, ihalted;
+    int nactive = 0;
+    
+    //Individuals of a lifecourse run that start later by their first step
+    std::vector< std::pair<int, int> > pending;
+    std::size_t npending = 0;
+    for (int k = 0; k < n; k++){
+        if (halt && failed[first + k] >= 0){
+            halted.push_back(k);
+            ihalted.push_back(start_ptr ? start_ptr[first + k] : 0);
+        } else if (start_ptr && start_ptr[first + k] > 0){
+            pending.push_back(std::make_pair(start_ptr[first + k], k));
+        } else if (!skip_ptr || !skip_ptr[first + k]){
+            active[nactive++] = k;
+        }
+    }
+    std::sort(pending.begin(), pending.end());
+    
+    const bool freeze = steady > 0;
+    std::vector<int> settled;
+    if (freeze){
+        settledRows(first, last, nsims, settled);
+    }
+    
+    for (int i = 1; i <= nsims && (nactive > 0 || npending < pending.size()); i++){
+        
+        const double t = TIME[i-1];
+        const int    r = out.report[i];
+        
+        //Those starting at t join the loop with its drivers
+        while (npending < pending.size() && pending[npending].first == i - 1){
+            const int k = pending[npending++].second;
+            drivers(t, first + k, start[k]);
+            active[nactive++] = k;
+        }
+        BW_PROFILE_RHS(4*nactive);
+        
+        for (int a = 0; a < nactive; a++){
+            
+            const int k = active[a];
+            const int j = first + k;
+            
+            //Exogenous inputs of the three stage times
+            const AdultDrivers &d0 = start[k];
+            drivers(t + 0.5 * dt, j, half[a]);
+            drivers(t + dt, j, full[a]);
+            
+            //Adaptive thermogenesis
+            const double at = AT[k];
+            k1 = dAT(at, d0);
+            k2 = dAT(at + 0.5 * dt * k1, half[a]);
+            k3 = dAT(at + 0.5 * dt * k2, half[a]);
+            k4 = dAT(at + dt * k3, full[a]);
+            at_new[a] = at + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            
+            //Extracellular fluid
+            const double ecf = ECF[k];
+            k1 = dECF(ecf, d0, j);
+            k2 = dECF(ecf + 0.5 * dt * k1, half[a], j);
+            k3 = dECF(ecf + 0.5 * dt * k2, half[a], j);
+            k4 = dECF(ecf + dt * k3, full[a], j);
+            ecf_new[a] = ecf + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            
+            //Glycogen
+            const double g = GLY[k];
+            k1 = dG(g, d0);
+            k2 = dG(g + 0.5 * dt * k1, half[a]);
+            k3 = dG(g + 0.5 * dt * k2, half[a]);
+            k4 = dG(g + dt * k3, full[a]);
+            g_new[a] = g + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+        }
+        
+        //Lean mass (same midpoints as rk4) one stage at a time for every active
+        //individual
+        for (int s = 0; s < 4; s++){
+            for (int a = 0; a < nactive; a++){
+                const int k = active[a];
+                lstage[a] = (s == 0) ? L[k] : L[k] + stage_c[s] * dt * kL[s-1][a];
+                ex[a]     = fatExponent(lstage[a], first + k);
+            }
+            vexp(ex, ex, nactive);
+            for (int a = 0; a < nactive; a++){
+                const int    k = active[a];
+                const int    j = first + k;
+                const double F = fat_ptr[j] * ex[a];
+                if (s == 0){
+                    kL[s][a] = dL(lstage[a], F, GLY[k], AT[k], ECF[k], start[k], j);
+                } else if (s < 3){
+                    kL[s][a] = dL(lstage[a], F, 0.5*(g_new[a] + GLY[k]), 0.5*(at_new[a] + AT[k]),
+                                  0.5*(ecf_new[a] + ECF[k]), half[a], j);
+                } else {
+                    kL[s][a] = dL(lstage[a], F, g_new[a], at_new[a], ecf_new[a], full[a], j);
+                }
+            }
+        }
+        
+        //New lean tissue (and its fat mass for the report)
+        for (int a = 0; a < nactive; a++){
+            const int k = active[a];
+            lstage[a] = L[k] + dt * (kL[0][a] + 2.0*kL[1][a] + 2.0*kL[2][a] + kL[3][a])/6.0;
+            ex[a]     = fatExponent(lstage[a], first + k);
+        }
+        if (r >= 0){
+            vexp(ex, ex, nactive);
+        }
+        
+        //Flags of the active individuals whose new state is invalid
+        bool invalid = false;
+        if (check){
+            const double inf = std::numeric_limits<double>::infinity();
+            invalid = vflag(at_new, -inf, bad.data(), nactive) |
+                      vflag(ecf_new, 0.0, bad.data(), nactive) |
+                      vflag(g_new, 0.0, bad.data(), nactive) |
+                      vflag(lstage, 0.0, bad.data(), nactive);
+        }
+        
+        int nkeep = 0;
+        for (int a = 0; a < nactive; a++){
+            
+            const int k = active[a];
+            const int j = first + k;
+            
+            const double at    = AT[k];
+            const double ecf   = ECF[k];
+            const double g     = GLY[k];
+            const double l_new = lstage[a];
+            
+            //Update states
+            AT[k]    = at_new[a];
+            ECF[k]   = ecf_new[a];
+            GLY[k]   = g_new[a];
+            L[k]     = l_new;
+            AGE[k]   = AGE[k] + dt/365.0;
+            start[k] = full[a];
+            
+            //Report (total intake at TIME[i] = t + dt)
+            if (r >= 0){
+                const double f_new = fat_ptr[j] * ex[a];
+                record(r, j, AGE[k], at_new[a], ecf_new[a], g_new[a], l_new, f_new,
+                       f_new + l_new + ecf_new[a] + 3.7*g_new[a], full[a].TI, out, part);
+            }
+            
+            //First invalid state (halted individuals leave the loop)
+            if (invalid && bad[a]){
+                bad[a] = 0;
+                if (failed[j] < 0){
+                    failed[j] = step0 + i;
+                }
+                if (halt){
+                    halted.push_back(k);
+                    ihalted.push_back(i);
+                    continue;
+                }
+            }
+            
+            //Individuals whose inputs no longer change leave the loop once AT, ECF
+            //and G are at steady state
+            if (freeze && i < nsims && i > settled[k] && fabs(at_new[a] - at) <= steady*dt &&
+                fabs(ecf_new[a] - ecf) <= steady*dt && fabs(g_new[a] - g) <= steady*dt){
+                frozen.push_back(k);
+                ifrozen.push_back(i);
+                continue;
+            }
+            active[nkeep++] = k;
+        }
+        nactive = nkeep;
+        
+        //State at the checkpoints (every individual is active, see rk4_fused)
+        if (!checkpoint_at.empty() && checkpoint_at[i] >= 0){
+            saveState(checkpoint_at[i], first, last, AT);
+        }
+    }
+    
+    //The rest of the trajectory of the individuals at steady state is the slow
+    //drift of L (the age term of the RMR keeps moving its equilibrium) which
+    //the adaptive method covers in a few steps
+    for (std::size_t f = 0; f < frozen.size(); f++){
+        const int k = frozen[f];
+        integrateAdaptive(first + k, ifrozen[f], nsims, TIME, AT[k], ECF[k], GLY[k], L[k], AGE[k],
+                          out, part);
+    }
+    
+    //Halted individuals report NA (but their age and intake) after their step
+    for (std::size_t h = 0; h < halted.size(); h++){
+        const int k = halted[h];
+        const int j = first + k;
+        double agek = AGE[k];
+        for (int i = ihalted[h] + 1; i <= nsims; i++){
+            agek = agek + dt/365.0;
+            const int r = out.report[i];
+            if (r >= 0){
+                AdultDrivers d;
+                drivers(TIME[i], j, d);
+                record(r, j, agek, NA_REAL, NA_REAL, NA_REAL, NA_REAL, NA_REAL, NA_REAL, d.TI,
+                       out, part);
+            }
+        }
+    }
+}
+
+//First row from which the inputs of each individual first, ..., last - 1 do not
+//change up to row nsims (rows are scanned backwards until every individual had
+//a change)
+void Adult::settledRows(int first, int last, int nsims, std::vector<int> &settled){
+    settled.assign(last - first, nsims);
+    int pending = last - first;
+    for (int row = nsims - 1; row >= 0 && pending > 0; row--){
+        pending = 0;
+        for (int j = first; j < last; j++){
+            int &s = settled[j - first];
+            if (s == row + 1 && EIrow(row, j) == EIrow(row + 1, j) &&
+                NArow(row, j) == NArow(row + 1, j) && PALrow(row, j) == PALrow(row + 1, j)){
+                s = row;
+                pending++;
+            }
+        }
+    }
+}
+
+//Save the state of the chunk first, ..., last - 1 (AT, ECF, G, L and age, each
+//of size last - first) as checkpoint c
+void Adult::saveState(int c, int first, int last, const double *state){
+    const int n = last - first;
+    for (int v = 0; v < 5; v++){
+        std::copy(state + v*n, state + (v + 1)*n, saved.begin() + ((std::size_t) 5*c + v)*nind + first);
+    }
+}
+
+//Checkpoint c taken at time (see setCheckpoints)
+List Adult::checkpoint(int c, double time){
+    
+    //Saved state of each variable
+    List state;
+    const char *names[] = {"Adaptive_Thermogenesis", "Extracellular_Fluid", "Glycogen",
+                           "Lean_Mass", "Age"};
+    for (int v = 0; v < 5; v++){
+        std::vector<double>::const_iterator x = saved.begin() + ((std::size_t) 5*c + v)*nind;
+        state.push_back(NumericVector(x, x + nind), names[v]);
+    }
+    
+    List constants = List::create(Named("bw") = bw, Named("ht") = ht, Named("ht2") = ht2,
+                                  Named("age") = age, Named("sex") = sex, Named("EI") = EI,
+                                  Named("fat") = fat, Named("lean") = lean,
+                                  Named("steadystate") = steadystate, Named("G_base") = G_base,
+                                  Named("ecfinit") = ecfinit, Named("CIb") = CIb,
+                                  Named("pcarb") = pcarb, Named("pcarb_base") = pcarb_base,
+                                  Named("kG") = kG, Named("K") = K, Named("rmr") = rmr,
+                                  Named("atinit") = atinit);
+    
+    List snapshot = List::create(Named("Model_Type") = "Adult",
+                                 Named("step")       = checkpoint_steps[c],
+                                 Named("time")       = time,
+                                 Named("dt")         = dt,
+                                 Named("state")      = state,
+                                 Named("constants")  = constants);
+    snapshot.attr("class") = "bw_checkpoint";
+    return snapshot;
+}
+
+//System of individual j with the inputs of one time step. With constant inputs
+//dAT and dECF are linear and dG is a Riccati equation none of which depend on L,
+//so AT, ECF and G (that relax within days) are solved exactly from their values
+//at t0 and only the slow lean tissue is left to the adaptive method.
+struct Adult::System {
+    Adult        *model;
+    int           j;
+    AdultDrivers  d;
+    
+    //AT, ECF and G at t0 and their equilibria
+    double t0, AT0, ECF0, G0;
+    double ATeq, ECFeq, Geq;
+    double kECF, kG;
+    
+    //Start the inputs d at t0 with AT, ECF and G
+    void start(double t, double AT, double ECF, double G){
+        t0   = t;
+        AT0  = AT;
+        ECF0 = ECF;
+        G0   = G;
+        ATeq = model->betaAT*d.dEI;
+        kECF = model->zetaNa/model->Na;
+        ECFeq = model->ecfinit_ptr[j] +
+                (d.dNA - model->zetaCI*(1.0 - d.CI/model->CIb_ptr[j]))/model->zetaNa;
+        Geq  = sqrt(fabs(d.CI)/model->kG_ptr[j]);
+        kG   = sqrt(fabs(d.CI)*model->kG_ptr[j])/model->roG;
+    }
+    
+    //Exact AT, ECF and G at time t
+    void fast(double t, double &AT, double &ECF, double &G){
+        const double s = t - t0;
+        AT  = ATeq  + (AT0 - ATeq)*exp(-s/model->tauAT);
+        ECF = ECFeq + (ECF0 - ECFeq)*exp(-kECF*s);
+        if (d.CI > 0){
+            const double th = tanh(kG*s);
+            G = Geq*(G0 + Geq*th)/(Geq + G0*th);
+        } else if (d.CI < 0){
+            const double tn = tan(kG*s);
+            G = Geq*(G0 - Geq*tn)/(Geq + G0*tn);
+        } else {
+            G = G0/(1.0 + model->kG_ptr[j]*G0*s/model->roG);
+        }
+    }
+    
+    //Lean tissue derivative (only the age term of the RMR changes with t)
+    void operator()(double t, const double *y, double *dy){
+        double AT, ECF, G;
+        fast(t, AT, ECF, G);
+        d.age492 = 4.92*(model->age_ptr[j] + (model->origin_ptr ? t - model->origin_ptr[j] : t)/365);
+        dy[0] = model->dL(y[0], G, AT, ECF, d, j);
+        BW_PROFILE_RHS(1);
+    }
+};
+
+//Adaptive Dormand Prince method for individuals first, ..., last - 1. Inputs are
+//constant within each time step, so each individual is integrated from one
+//change of its inputs to the next as a smooth problem. The states at the grid
+//TIME (the same as rk4) are obtained from the dense output. Individuals of a
+//lifecourse run start at their own step (whose baseline the children report).
+void Adult::integrateAdaptive(int first, int last, int nsims, const double *TIME,
+                              ModelOutput &out, ModelOutputPartial &part){
+    for (int j = first; j < last; j++){
+        if (skip_ptr && skip_ptr[j]){
+            continue;
+        }
+        const int i0 = start_ptr ? start_ptr[j] : 0;
+        if (out.report[0] >= 0 && !start_ptr){
+            record(0, j, age_ptr[j], atinit_ptr[j], ecfinit_ptr[j], G_base_ptr[j], lean_ptr[j],
+                   fatMass(lean_ptr[j], j), bw_ptr[j], EI_ptr[j], out, part);
+        }
+        if (check && !validState(atinit_ptr[j], ecfinit_ptr[j], G_base_ptr[j], lean_ptr[j])){
+            failed[j] = step0 + i0;
+        }
+        integrateAdaptive(j, i0, nsims, TIME, atinit_ptr[j], ecfinit_ptr[j], G_base_ptr[j],
+                          lean_ptr[j], age_ptr[j], out, part);
+    }
+}
+
+//Same for individual j from TIME[i0] (with states AT, ECF, G, L and AGE) on.
+//A halted individual is integrated up to the next change of its inputs after
+//its first invalid state and reports NA from that state on.
+void Adult::integrateAdaptive(int j, int i0, int nsims, const double *TIME, double AT,
+                              double ECF, double G, double L, double AGE,
+                              ModelOutput &out, ModelOutputPartial &part){
+    
+    System f;
+    f.model = this;
+    f.j     = j;
+    DormandPrince<1> solver(tolerance);
+    
+    //Reports the grid points of every accepted step
+    int  i       = i0 + 1;
+    bool stopped = halt && failed[j] >= 0;
+    auto emit = [&](const DormandPrince<1> &step, const double *ynew) -> bool {
+        for (; i <= nsims && TIME[i] <= step.t_new; i++){
+            double Li;
+            if (TIME[i] == step.t_new){
+                Li = ynew[0];
+            } else {
+                step.dense(TIME[i], &Li);
+            }
+            AGE = AGE + dt/365.0;
+            const int r = out.report[i];
+            if (r < 0 && !check){
+                continue;
+            }
+            double ATi, ECFi, Gi;
+            f.fast(TIME[i], ATi, ECFi, Gi);
+            if (stopped){
+                ATi = ECFi = Gi = Li = NA_REAL;
+            } else if (check && !validState(ATi, ECFi, Gi, Li)){
+                if (failed[j] < 0){
+                    failed[j] = step0 + i;
+                }
+                stopped = halt;
+            }
+            if (r >= 0){
+                const double F = fatMass(Li, j);
+                record(r, j, AGE, ATi, ECFi, Gi, Li, F, F + Li + ECFi + 3.7*Gi,
+                       EI_ptr[j] + deltaEI(TIME[i], j), out, part);
+            }
+        }
+        return !stopped;
+    };
+    
+    //Steps row0, ..., row1 - 1 have the same inputs
+    int row0 = i0;
+    while (row0 < nsims && !stopped){
+        int row1 = row0 + 1;
+        while (row1 < nsims && EIrow(row1, j) == EIrow(row0, j) &&
+               NArow(row1, j) == NArow(row0, j) && PALrow(row1, j) == PALrow(row0, j)){
+            row1++;
+        }
+        drivers(row0, TIME[row0], j, f.d);
+        f.start(TIME[row0], AT, ECF, G);
+        double h = dt;
+        solver.integrate(f, TIME[row0], &L, TIME[row1], h, emit);
+        f.fast(TIME[row1], AT, ECF, G);
+        row0 = row1;
+    }
+    
+    //Grid points after a halt
+    for (; i <= nsims; i++){
+        AGE = AGE + dt/365.0;
+        const int r = out.report[i];
+        if (r >= 0){
+            record(r, j, AGE, NA_REAL, NA_REAL, NA_REAL, NA_REAL, NA_REAL, NA_REAL,
+                   EI_ptr[j] + deltaEI(TIME[i], j), out, part);
+        }
+    }
+}
+
+//Integrate a chunk of individuals with the method chosen in setSolver
+void Adult::integrateChunk(int first, int last, int nsims, const double *TIME,
+                           ModelOutput &out, ModelOutputPartial &part){
+    BW_PROFILE_CHUNK();
+    if (adaptive){
+        integrateAdaptive(first, last, nsims, TIME, out, part);
+    } else {
+        integrateFused(first, last, nsims, TIME, out, part);
+    }
+}
+
+//Rungue Kutta 4 method for Adult evaluating the four ODEs of each individual in a
+//single loop over plain doubles instead of NumericVector operations.
+//Individuals are split in chunks of chunk_size that are integrated by up to
+//threads workers. As individuals are independent and each one is always
+//integrated by the same code, results do not depend on the number of threads.
+List Adult::rk4_fused(double days, int threads){
+    std::vector<std::string> vars(adult_variables, adult_variables + OUT_TEI + 1);
+    vars.push_back("BMI_Category");
+    return rk4_fused(days, threads, List::create(Named("vars")       = vars,
+                                                 Named("stride")     = 1,
+                                                 Named("summary")    = "none",
+                                                 Named("group")      = IntegerVector(0),
+                                                 Named("weights")    = NumericVector(0),
+                                                 Named("strata")     = IntegerVector(0),
+                                                 Named("categories") = "character"));
+}
+
+//Same as rk4_fused but only the output requested is kept:
+//  vars       .-  Variables to keep.
+//  stride     .-  Report every stride steps.
+//  summary    .-  "none", "final" (only the last state) or "mean" (weighted
+//                 mean, its standard error and variance by group; BMI_Category
+//                 gives the prevalence).
+//  group      .-  Group (1, ..., ngroups) of each individual for summary = "mean".
+//  weights    .-  Survey weight of each individual for summary = "mean".
+//  strata     .-  Stratum (1, ..., nstrata) of each individual for summary = "mean".
+//  categories .-  BMI_Category as "character" or "integer" codes (see BMICode).
+//  cells      .-  (Optional) Size of each individual when it stands for a cell of
+//                 identical individuals for summary = "mean" (see ModelOutput).
+//  precision  .-  (Optional) Storage of the values of summary "none" and "final":
+//                 "double" (default), "float", "int32" or "int16" (see OutputStore).
+//  resolution .-  (Optional) Named list with the resolution of the fixed point
+//                 codes of each variable (1 if not given).
+//  path       .-  (Optional) Directory where the values of summary "none" and
+//                 "final" are written (see ModelOutput). BMI_Category is then
+//                 written as its codes.
+//  sensitivity.-  (Optional) Parameters whose sensitivities are returned in
+//                 Sensitivity (see sensitivity).
+//  sums       .-  (Optional) Whether summary = "mean" also returns the sums of
+//                 each group and stratum in Sums (see ModelOutput::sums).
+//The states of the steps of setCheckpoints are returned in Checkpoint and a
+//resumed run only returns the steps from its checkpoint on.
+//When summarising, chunk accumulators are merged in chunk order so the summary
+//does not depend on the number of threads either.
+List Adult::rk4_fused(double days, int threads, List output){
+    
+    std::vector<std::string> vars = as< std::vector<std::string> >(output["vars"]);
+    const int         stride      = as<int>(output["stride"]);
+    const std::string summary     = as<std::string>(output["summary"]);
+    const bool        codes       = as<std::string>(output["categories"]) == "integer";
+    IntegerVector     group       = as<IntegerVector>(output["group"]);
+    NumericVector     weights     = as<NumericVector>(output["weights"]);
+    IntegerVector     strata      = as<IntegerVector>(output["strata"]);
+    List              cells       = output.containsElementNamed("cells") ? as<List>(output["cells"]) : List();
+    const std::string precision   = output.containsElementNamed("precision") ? as<std::string>(output["precision"]) : "double";
+    List              resolution  = output.containsElementNamed("resolution") ? as<List>(output["resolution"]) : List();
+    const std::string path        = output.containsElementNamed("path") ? as<std::string>(output["path"]) : "";
+    std::vector<std::string> sens = output.containsElementNamed("sensitivity") ? as< std::vector<std::string> >(output["sensitivity"]) : std::vector<std::string>();
+    const bool        sums        = output.containsElementNamed("sums") && as<bool>(output["sums"]);
+    BW_PROFILE_PHASE("setup");
+    
+    //Estimate number of elements to loop into (after the checkpoint when resuming)
+    const int nsteps = inputSteps(days);
+    const int nsims  = nsteps - step0;
+    if (nsims < 0){
+        stop("Invalid days. A resumed run must end after its checkpoint.");
+    }
+    
+    //Steps whose state is saved. The state of RK4 is the whole state of the
+    //model only if no individual leaves its loop.
+    if ((checkpoint_steps.size() > 0 || step0 > 0) && (adaptive || steady > 0)){
+        stop("Invalid checkpoint. Checkpoints require method = 'RK4' and steady = 0.");
+    }
+    checkpoint_at.assign(checkpoint_steps.empty() ? 0 : nsims + 1, -1);
+    for (std::size_t c = 0; c < checkpoint_steps.size(); c++){
+        const int i = checkpoint_steps[c] - step0;
+        if (i < 1 || i > nsims){
+            stop("Invalid checkpoint. Checkpoints must be taken after the start and before the end of the run.");
+        }
+        checkpoint_at[i] = c;
+    }
+    saved.assign((std::size_t) 5*checkpoint_steps.size()*nind, NA_REAL);
+    if (sens.size() > 0 && step0 > 0){
+        stop("Invalid sensitivity. Sensitivities are integrated from baseline (not from a checkpoint).");
+    }
+    
+    //BMI_Category is labelled from its stored codes once integration is over
+    //(or summarised by the prevalence of each category)
+    std::vector<std::string>::iterator cat = std::find(vars.begin(), vars.end(), "BMI_Category");
+    bool category = cat != vars.end();
+    if (category){
+        vars.erase(cat);
+    }
+    if (category && summary == "mean"){
+        for (int k = OUT_UNDERWEIGHT; k <= OUT_OBESE; k++){
+            vars.push_back(adult_variables[k]);
+        }
+        category = false;
+    }
+    
+    std::vector<std::string> available(adult_variables, adult_variables + nadult_variables);
+    ModelOutput out(available, vars, stride, nsims, nind, summary, group, weights, strata,
+                    nscen, cells, precision, getResolution(resolution, available), path);
+    if (category){
+        out.require(OUT_CATEGORY, "int16", 1.0, out.writes());
+    }
+    
+    //Time is computed beforehand so that floor(t/dt) coincides with rk4 (from
+    //baseline so that a resumed run has the same times)
+    NumericVector TIME(nsteps + 1); //in rcpp
+    TIME(0)  = 0.0;
+    for (int i = 1; i <= nsteps; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    
+    //Workers only see plain pointers (no R API is called outside the main thread)
+    const double *time_ptr = TIME.begin() + step0;
+    failed.assign(nind, -1);
+    
+    //Integrate every individual by chunks
+    BW_PROFILE_PHASE("integrate");
+    const int nchunks = (nind + chunk_size - 1)/chunk_size;
+    if (out.reduces()){
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(std::max(threads, 1))
+#endif
+        {
+            ModelOutputPartial part = out.partial();
+#ifdef _OPENMP
+            #pragma omp for ordered schedule(static, 1)
+#endif
+            for (int c = 0; c < nchunks; c++){
+                part.reset();
+                integrateChunk(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims, time_ptr,
+                               out, part);
+#ifdef _OPENMP
+                #pragma omp ordered
+#endif
+                out.merge(part);
+            }
+        }
+    } else {
+        ModelOutputPartial part;
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1) firstprivate(part)
+#endif
+        for (int c = 0; c < nchunks; c++){
+            integrateChunk(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims, time_ptr,
+                           out, part);
+        }
+    }
+    
+    BW_PROFILE_PHASE("wrap");
+    List results = out.wrap(NumericVector(TIME.begin() + step0, TIME.end()));
+    if (sums && out.reduces()){
+        results.push_back(out.sums(), "Sums");
+    }
+    
+    //Classify BMI (with the same dimensions as the other variables)
+    if (category && !out.writes()){
+        BW_PROFILE_PHASE("categories");
+        const OutputStore &codestore = out.values(OUT_CATEGORY);
+        IntegerVector CAT(codestore.size); //in rcpp
+        for (int k = 0; k < CAT.size(); k++){
+            const double code = codestore.get(k);
+            CAT[k] = ISNAN(code) ? NA_INTEGER : (int) code;
+        }
+        if (codes){
+            results.push_back(out.shape(CAT), "BMI_Category");
+        } else {
+            results.push_back(out.shape(BMILabel(CAT)), "BMI_Category");
+        }
+        BW_PROFILE_PHASE("wrap");
+    }
+    
+    //Derivatives of the body weight
+    if (sens.size() > 0){
+        BW_PROFILE_PHASE("sensitivity");
+        results.push_back(sensitivity(sens, stride, nsims, summary, group, weights, strata, cells,
+                                      TIME, threads), "Sensitivity");
+        BW_PROFILE_PHASE("wrap");
+    }
+    
+    //Saved states
+    if (checkpoint_steps.size() > 0){
+        List checkpoints;
+        for (std::size_t c = 0; c < checkpoint_steps.size(); c++){
+            checkpoints.push_back(checkpoint(c, TIME[checkpoint_steps[c]]));
+        }
+        results.push_back(checkpoints, "Checkpoint");
+    }
+    
+    //Individuals whose state was valid at every step
+    out.validity(results, failed, TIME);
+    results.push_back("Adult", "Model_Type");
+    
+    return results;
+    
+}
+
+//Derivatives of the body weight with respect to the parameters vars (any of
+//adult_parameters) reported as the variables of rk4_fused with stride and
+//summary. Every individual is integrated again by RK4 (whatever the method of
+//setSolver) with dual numbers carrying the derivatives, so a single pass gives
+//the sensitivities of every parameter. Constants of the baseline that depend
+//on a parameter (EI, K and the glycogen constants) are differentiated too, so
+//each derivative is the limit of the finite differences of two runs.
+List Adult::sensitivity(std::vector<std::string> vars, int stride, int nsims, std::string summary,
+                        IntegerVector group, NumericVector weights, IntegerVector strata,
+                        List cells, NumericVector TIME, int threads){
+    
+    std::vector<std::string> available(adult_parameters, adult_parameters + nadult_parameters);
+    std::vector<int> which;
+    for (std::size_t k = 0; k < vars.size(); k++){
+        std::vector<std::string>::iterator v = std::find(available.begin(), available.end(), vars[k]);
+        if (v == available.end()){
+            stop("Invalid sensitivity. Please specify any of: 'betaAT', 'tauAT', 'betaTEF', 'gammaF', 'gammaL', 'etaF', 'etaL', 'PAL', 'pcarb'.");
+        }
+        which.push_back(v - available.begin());
+    }
+    ModelOutput out(available, vars, stride, nsims, nind, summary, group, weights, strata,
+                    nscen, cells);
+    
+    //Workers only see plain pointers (no R API is called outside the main thread)
+    const double *time_ptr = TIME.begin();
+    
+    const int nchunks = (nind + chunk_size - 1)/chunk_size;
+    if (out.reduces()){
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(std::max(threads, 1))
+#endif
+        {
+            ModelOutputPartial part = out.partial();
+#ifdef _OPENMP
+            #pragma omp for ordered schedule(static, 1)
+#endif
+            for (int c = 0; c < nchunks; c++){
+                part.reset();
+                integrateSensitivity(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims,
+                                     time_ptr, which, out, part);
+#ifdef _OPENMP
+                #pragma omp ordered
+#endif
+                out.merge(part);
+            }
+        }
+    } else {
+        ModelOutputPartial part;
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1) firstprivate(part)
+#endif
+        for (int c = 0; c < nchunks; c++){
+            integrateSensitivity(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims,
+                                 time_ptr, which, out, part);
+        }
+    }
+    
+    return out.wrap(TIME);
+}
+
+//Sensitivities of individuals first, ..., last - 1 with duals of as few
+//derivatives as the parameters in which
+void Adult::integrateSensitivity(int first, int last, int nsims, const double *TIME,
+                                 const std::vector<int> &which, ModelOutput &out,
+                                 ModelOutputPartial &part){
+    const int n = which.size();
+    if (n == 1){
+        integrateSensitivity<1>(first, last, nsims, TIME, which, out, part);
+    } else if (n == 2){
+        integrateSensitivity<2>(first, last, nsims, TIME, which, out, part);
+    } else if (n <= 4){
+        integrateSensitivity<4>(first, last, nsims, TIME, which, out, part);
+    } else {
+        integrateSensitivity<nadult_parameters>(first, last, nsims, TIME, which, out, part);
+    }
+}
+
+//Same with duals of N derivatives (derivative k is that of parameter which[k],
+//the rest are 0). Each individual follows the RK4 scheme of integrateFused with
+//the right-hand sides evaluated over duals (and exp instead of vexp).
+template <int N>
+void Adult::integrateSensitivity(int first, int last, int nsims, const double *TIME,
+                                 const std::vector<int> &which, ModelOutput &out,
+                                 ModelOutputPartial &part){
+    
+    typedef Dual<N> D;
+    
+    //Parameters (and shifts of PAL and pcarb) seeded with their derivatives
+    const double values[nadult_parameters] = {betaAT, tauAT, betaTEF, gammaF, gammaL,
+                                              etaF, etaL, 0.0, 0.0};
+    D seed[nadult_parameters];
+    for (int q = 0; q < nadult_parameters; q++){
+        seed[q] = D(values[q]);
+    }
+    for (std::size_t k = 0; k < which.size(); k++){
+        seed[which[k]] = D::variable(values[which[k]], k);
+    }
+    AdultParameters<D> p;
+    p.betaAT  = seed[SENS_BETAAT];
+    p.tauAT   = seed[SENS_TAUAT];
+    p.betaTEF = seed[SENS_BETATEF];
+    p.gammaF  = seed[SENS_GAMMAF];
+    p.gammaL  = seed[SENS_GAMMAL];
+    p.alfa1   = -(1 + seed[SENS_ETAL]/roL)*C;
+    p.alfa2   = -(1 + seed[SENS_ETAF]/roF);
+    
+    for (int j = first; j < last; j++){
+        
+        //Constants of the baseline (as getCaloricSteadyState, getK and getCarbConstants)
+        const D PAL0 = PALview.value(0, j) + seed[SENS_PAL];
+        AdultBaseline<D> b;
+        b.EI    = estimatedEI ? rmr_ptr[j]*PAL0 : D(EI_ptr[j]);
+        b.pcarb = pcarb_ptr[j] + seed[SENS_PCARB];
+        b.PAL   = seed[SENS_PAL];
+        b.K     = rmr_ptr[j]*PAL0 - p.gammaL*lean_ptr[j] - p.gammaF*fat_ptr[j] -
+                  ((1.0 - p.betaTEF)*PAL0 - 1.0)*rmr_ptr[j]/bw_ptr[j]*bw_ptr[j];
+        b.CIb   = pcarb_base_ptr[j]*b.EI;
+        b.kG    = b.CIb/pow(G_base_ptr[j], 2.0);
+        
+        D AT  = atinit_ptr[j];
+        D ECF = ecfinit_ptr[j];
+        D G   = G_base_ptr[j];
+        D L   = lean_ptr[j];
+        
+        AdultDriversOf<D> start, half, full;
+        drivers((int) floor(TIME[0]/dt), TIME[0], j, b, p, start);
+        if (out.report[0] >= 0){
+            const D BW = fatMass(L, j) + L + ECF + 3.7*G;
+            for (std::size_t k = 0; k < which.size(); k++){
+                out.put(which[k], 0, j, BW.d[k], part);
+            }
+        }
+        
+        for (int i = 1; i <= nsims; i++){
+            
+            const double t = TIME[i-1];
+            drivers((int) floor((t + 0.5 * dt)/dt), t + 0.5 * dt, j, b, p, half);
+            drivers((int) floor((t + dt)/dt), t + dt, j, b, p, full);
+            
+            D k1, k2, k3, k4;
+            k1 = dAT(AT, start, p);
+            k2 = dAT(AT + 0.5 * dt * k1, half, p);
+            k3 = dAT(AT + 0.5 * dt * k2, half, p);
+            k4 = dAT(AT + dt * k3, full, p);
+            const D at_new = AT + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            
+            k1 = dECF(ECF, start, j);
+            k2 = dECF(ECF + 0.5 * dt * k1, half, j);
+            k3 = dECF(ECF + 0.5 * dt * k2, half, j);
+            k4 = dECF(ECF + dt * k3, full, j);
+            const D ecf_new = ECF + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            
+            k1 = dG(G, start);
+            k2 = dG(G + 0.5 * dt * k1, half);
+            k3 = dG(G + 0.5 * dt * k2, half);
+            k4 = dG(G + dt * k3, full);
+            const D g_new = G + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            
+            //Lean tissue with the same midpoints as integrateFused
+            D l1 = L;
+            k1 = dL(l1, fatMass(l1, j), G, AT, ECF, start, p);
+            D l2 = L + 0.5 * dt * k1;
+            k2 = dL(l2, fatMass(l2, j), 0.5*(g_new + G), 0.5*(at_new + AT), 0.5*(ecf_new + ECF), half, p);
+            D l3 = L + 0.5 * dt * k2;
+            k3 = dL(l3, fatMass(l3, j), 0.5*(g_new + G), 0.5*(at_new + AT), 0.5*(ecf_new + ECF), half, p);
+            D l4 = L + dt * k3;
+            k4 = dL(l4, fatMass(l4, j), g_new, at_new, ecf_new, full, p);
+            
+            AT    = at_new;
+            ECF   = ecf_new;
+            G     = g_new;
+            L     = L + dt * (k1 + 2.0*k2 + 2.0*k3 + k4)/6.0;
+            start = full;
+            
+            const int r = out.report[i];
+            if (r >= 0){
+                const D BW = fatMass(L, j) + L + ECF + 3.7*G;
+                for (std::size_t k = 0; k < which.size(); k++){
+                    out.put(which[k], r, j, BW.d[k], part);
+                }
+            }
+        }
+    }
+}
+
+//Sustained change of energy intake (added to EIchange at every time step) with
+//which each individual weighs the target at days:
+//  weight     .-  Target body weight of each individual (kg).
+//  accuracy   .-  Largest difference between the final and the target weight (kg).
+//  maxit      .-  Largest number of runs of each individual.
+//The final weight is a smooth increasing function of the change so each
+//individual takes secant steps, the first one from no change with the rule of
+//thumb of Hall et al. (2011) of 22 kcal/day per kg with half of the change
+//reached in a year. Every individual iterates at the same time in one run of
+//rk4_fused per iteration (sharing the baseline computed by the constructor) and
+//those that converged are skipped by the following runs. Individuals whose step
+//makes no progress (or whose total intake would be negative at baseline) stop
+//without converging.
+List Adult::target(double days, int threads, List target){
+    
+    NumericVector weight   = as<NumericVector>(target["weight"]);
+    const double  accuracy = as<double>(target["accuracy"]);
+    const int     maxit    = as<int>(target["maxit"]);
+    if (weight.size() != nind || nscen != 1 || step0 > 0 || checkpoint_steps.size() > 0){
+        stop("Invalid target. Please specify the target weight of each individual.");
+    }
+    if (inputSteps(days) < 1){
+        stop("Invalid days. The target must be reached after at least one time step.");
+    }
+    
+    //Only the final weight of each run is kept
+    List output = List::create(Named("vars")       = std::vector<std::string>(1, "Body_Weight"),
+                               Named("stride")     = 1,
+                               Named("summary")    = "final",
+                               Named("group")      = IntegerVector(0),
+                               Named("weights")    = NumericVector(0),
+                               Named("strata")     = IntegerVector(0),
+                               Named("categories") = "character");
+    
+    //Change of the current and previous iteration of each individual and the
+    //difference with the target of the previous one
+    std::vector<double> change(nind, 0.0), previous(nind, 0.0), residual(nind, NA_REAL);
+    std::vector<char>   done(nind, 0);
+    NumericVector       final(nind, NA_REAL);  //in rcpp
+    IntegerVector       iterations(nind);      //in rcpp
+    LogicalVector       converged(nind);       //in rcpp
+    shift_ptr = &change[0];
+    skip_ptr  = &done[0];
+    
+    //Weight gained within days by each kcal/day of change
+    const double slope = (1.0 - exp(-days*log(2.0)/365.0))/22.0;
+    
+    int nactive = nind;
+    for (int it = 1; it <= maxit && nactive > 0; it++){
+        
+        NumericVector BW = as<NumericVector>(rk4_fused(days, threads, output)["Body_Weight"]);
+        
+        nactive = 0;
+        for (int j = 0; j < nind; j++){
+            if (done[j]){
+                continue;
+            }
+            iterations[j] = it;
+            final[j]      = BW[j];
+            
+            const double f = BW[j] - weight[j];
+            if (fabs(f) <= accuracy){
+                converged[j] = true;
+                done[j]      = 1;
+                continue;
+            }
+            
+            //Secant step (the first one with the rule of thumb)
+            const double step = (it == 1) ? f/slope : f*(change[j] - previous[j])/(f - residual[j]);
+            const double next = std::max(change[j] - step, -EI_ptr[j]);
+            if (it == maxit || !std::isfinite(next) || next == change[j]){
+                done[j] = 1;
+                continue;
+            }
+            previous[j] = change[j];
+            residual[j] = f;
+            change[j]   = next;
+            nactive++;
+        }
+    }
+    
+    shift_ptr = NULL;
+    skip_ptr  = NULL;
+    
+    return List::create(Named("EIchange")    = NumericVector(change.begin(), change.end()),
+                        Named("Body_Weight") = final,
+                        Named("Iterations")  = iterations,
+                        Named("Converged")   = converged,
+                        Named("Model_Type")  = "Adult");
+}
@@ -32,10 +32,57 @@
 
 #include <math.h>
 #include <Rcpp.h>
+#include "model_output.h"
+#include "energy_knots.h"
+#include "input_view.h"
+#include "dormand_prince.h"
 using namespace Rcpp;
 
-//Create a Adult class to contain individual parameters
+//Exogenous drivers of an individual at one time point of a RK4 step. They are
+//evaluated once per time point and shared by the AT, ECF, G and L equations.
+//T is the scalar type (double or a Dual of the sensitivities, see
+//dual_number.h) of the terms that depend on the parameters of the model.
 //--------------------------------------------------------------------------------
+template <typename T>
+struct AdultDriversOf {
+    double dEI;      //Change in energy intake (deltaEI)
+    double dNA;      //Change in sodium (deltaNA)
+    T      TI;       //Total intake (TotalIntake)
+    T      CI;       //Carbohydrate intake (CI)
+    T      coef;     //(1 - betaTEF)*PAL - 1 of delta_times_bw
+    double ht625;    //Height term of the RMR in delta_times_bw
+    double age492;   //Age term of the RMR in delta_times_bw
+    double sex166;   //Sex term of the RMR in delta_times_bw
+    T      K;        //Energy balance constant at baseline
+    T      CIb;      //Carbohydrate intake at baseline
+    T      kG;       //Glycogen constant
+};
+typedef AdultDriversOf<double> AdultDrivers;
+
+//Parameters of the population in the right-hand sides of the ODEs
+template <typename T>
+struct AdultParameters {
+    T betaAT;
+    T tauAT;
+    T betaTEF;
+    T gammaF;
+    T gammaL;
+    T alfa1;   //-(1 + etaL/roL)*C
+    T alfa2;   //-(1 + etaF/roF)
+};
+
+//Constants of an individual that depend on the parameters (PAL and pcarb are
+//the shifts of the inputs, 0 but for their sensitivities)
+template <typename T>
+struct AdultBaseline {
+    T EI;
+    T pcarb;
+    T PAL;
+    T K;
+    T CIb;
+    T kG;
+};
+
 class Adult {
 public:
     
@@ -62,10 +109,14 @@ public:
     //Destroyer
     ~ Adult();
     
+    //Names of the variables of rk4_fused (in output order)
+    static std::vector<std::string> variables(void);
+    
     //Constants depending on the Adult
     //---------------------------------------------------------------------------
     NumericVector bw;              //Weight (kg)
     NumericVector ht;              //Height (m)
+    NumericVector ht2;             //Squared height for the BMI (m^2)
     NumericVector age;             //Age (yrs)
     NumericVector sex;             //0 = "male"; 1 = "female"
     NumericVector EI;              //Energy intake (kcal)
@@ -79,18 +130,36 @@ public:
     NumericVector pcarb;           //% carbohydrates after change
     NumericVector pcarb_base;      //% carbohydrates at baseline
     
-    //Numeric vectors containing EI and NA changes
+    //Numeric vectors containing EI and NA changes (nind x days, like PAL, so that
+    //each time step is a contiguous column). Any of them may have a single row
+    //(the same for every individual) or a single column (the same every day).
     NumericMatrix EIchange;
     NumericMatrix NAchange;
     
+    //Knots of EI and NA changes evaluated on demand instead of EIchange and
+    //NAchange (see setKnots)
+    EnergyKnots EIknots;
+    EnergyKnots NAknots;
+    
 
     
     //Functions
     //---------------------------------------------------------------------------
     List rk4(double days); //in Rcpp:
+    List rk4_fused(double days, int threads = 1); //Same as rk4 but allocation-free over plain doubles
+    List rk4_fused(double days, int threads, List output); //Only keeps (or summarises) the output requested
+    void setKnots(List knots); //Use knots for EIchange and (or) NAchange
+    void setSolver(List solver); //Integration method of rk4_fused ("RK4" or "RK45")
+    void setScenarios(int nscenarios, NumericMatrix input_EIchange,
+                      NumericMatrix input_NAchange, NumericMatrix physicalactivity); //Several inputs per individual
+    void setCheckpoints(List checkpoints); //Save (or resume from) the state of rk4_fused
+    List target(double days, int threads, List target); //Sustained EI change that reaches a target weight
     
 private:
     
+    //Lifecourse continues the children that become adults with the fused engine
+    friend class Lifecourse;
+    
     //Constants depending on the Adult
     //---------------------------------------------------------------------------
     NumericVector kG;              //Constant
@@ -122,9 +191,71 @@ private:
     double rmrht;
     double rmr_m;
     double rmr_f;
-    int    nind; //Number of individuals in model
+    int    nind; //Number of individuals in model (times the number of scenarios)
+    int    nscen;//Number of scenarios of each individual (see setScenarios)
     double dt;   //Delta t for Rungue Kutta 4
     bool check;
+    bool   halt;      //Stop integrating the individuals whose state is invalid (see setSolver)
+    bool   adaptive;  //Use the adaptive Dormand Prince method instead of RK4
+    double tolerance; //Relative and absolute tolerance of the adaptive method
+    double steady;    //Convergence of AT, ECF and G to stop RK4 (0 never; see setSolver)
+    
+    //Checkpoints of rk4_fused (see setCheckpoints)
+    std::vector<int>    checkpoint_steps; //Time steps whose state is saved
+    std::vector<int>    checkpoint_at;    //Checkpoint of each step integrated (-1 if none)
+    std::vector<double> saved;            //AT, ECF, G, L and age of every individual at each checkpoint
+    std::vector<double> state0;           //AT, ECF, G, L and age at step0 (empty from baseline)
+    int                 step0;            //Time step at which the integration starts
+    
+    //First time step (from baseline) at which the state of each individual of
+    //rk4_fused is invalid, -1 if it never is (see validState)
+    std::vector<int>    failed;
+    
+    //Sensitivities of rk4_fused (see sensitivity)
+    AdultParameters<double> parameters;   //Parameters of the ODEs
+    bool                    estimatedEI;  //Whether EI is the steady state of the baseline PAL
+    
+    //Batched solution of target: sustained change of energy intake of each
+    //individual added to its EIchange and individuals skipped by rk4_fused
+    //(NULL outside of target)
+    const double *shift_ptr;
+    const char   *skip_ptr;
+    
+    //Lifecourse run (see lifecourse.h): time step from which each individual is
+    //integrated (its baseline is the state at that step, which is not reported)
+    //and its TIME, from which its age is counted (NULL outside of Lifecourse)
+    const int    *start_ptr;
+    const double *origin_ptr;
+    
+    //System of ODEs of an individual for the adaptive method
+    struct System;
+    
+    //Raw views of the individual constants and inputs for the fused engine
+    //(set by getBuffers once every NumericVector has its final value)
+    //---------------------------------------------------------------------------
+    const double *bw_ptr;
+    const double *ht_ptr;
+    const double *ht2_ptr;
+    const double *age_ptr;
+    const double *sex_ptr;
+    const double *EI_ptr;
+    const double *fat_ptr;
+    const double *lean_ptr;
+    const double *ecfinit_ptr;
+    const double *atinit_ptr;
+    const double *G_base_ptr;
+    const double *CIb_ptr;
+    const double *pcarb_ptr;
+    const double *kG_ptr;
+    const double *K_ptr;
+    const double *rmr_ptr;
+    const double *pcarb_base_ptr;
+    
+    //Broadcasting views of EIchange, NAchange and PAL (see getInputs)
+    InputView     EIview;
+    InputView     NAview;
+    InputView     PALview;
+    int           nstep_input;   //Time steps of the inputs that change over time (0 if none does)
     
     //Auxiliary functions
     void getRMR(void);
@@ -134,9 +265,13 @@ private:
     void getEnergy(void);
     //void getDelta(void);
     void getK(void);
+    void getK(NumericVector PAL_base);
     void getCarbConstants(void);
     void getATinit(void);
     void getECFinit(void);
+    void getBuffers(void);
+    void getInputs(void);
+    double inputSteps(double days);
     void build(NumericVector weight, NumericVector height, NumericVector age_yrs,
                NumericVector sexstring, NumericMatrix input_EIchange,
                NumericMatrix input_NAchange, NumericMatrix physicalactivity,
@@ -153,6 +288,8 @@ private:
                NumericVector input_fat,bool checkValues);
     NumericVector TotalIntake (double t);
     StringVector  BMIClassifier(NumericVector BMI);
+    StringVector  BMILabel(IntegerVector code);
+    IntegerVector BMICode(NumericVector BMI);
     NumericVector CI(double t);
     NumericVector R(double t, NumericVector L, NumericVector G,
                     NumericVector AT, NumericVector ECF);
@@ -168,6 +305,59 @@ private:
     NumericVector dL(double t, NumericVector L, NumericVector G,
                      NumericVector AT, NumericVector ECF);
     
+    //Scalar versions for individual j used by the fused engine
+    double deltaEI(double t, int j);
+    double deltaNA(double t, int j);
+    double deltaPAL(double t, int j);
+    double EIrow(int row, int j);
+    double NArow(int row, int j);
+    double PALrow(int row, int j);
+    template <typename T> T fatExponent(const T &L, int j);
+    template <typename T> T fatMass(const T &L, int j);
+    void   drivers(double t, int j, AdultDrivers &d);
+    void   drivers(int row, double t, int j, AdultDrivers &d);
+    double R(double L, double G, double AT, double ECF, const AdultDrivers &d, int j);
+    double R(double L, double F, double G, double AT, double ECF, const AdultDrivers &d, int j);
+    double dAT(double AT, const AdultDrivers &d);
+    double dL(double L, double G, double AT, double ECF, const AdultDrivers &d, int j);
+    double dL(double L, double F, double G, double AT, double ECF, const AdultDrivers &d, int j);
+    
+    //Right-hand sides for any scalar type T (see AdultDriversOf)
+    template <typename T> void drivers(int row, double t, int j, const AdultBaseline<T> &b,
+                                       const AdultParameters<T> &p, AdultDriversOf<T> &d);
+    template <typename T> T R(const T &L, const T &F, const T &G, const T &AT, const T &ECF,
+                              const AdultDriversOf<T> &d, const AdultParameters<T> &p);
+    template <typename T> T dAT(const T &AT, const AdultDriversOf<T> &d, const AdultParameters<T> &p);
+    template <typename T> T dECF(const T &ECF, const AdultDriversOf<T> &d, int j);
+    template <typename T> T dG(const T &G, const AdultDriversOf<T> &d);
+    template <typename T> T dL(const T &L, const T &F, const T &G, const T &AT, const T &ECF,
+                               const AdultDriversOf<T> &d, const AdultParameters<T> &p);
+    int    BMICode(double BMI);
+    void   record(int r, int j, double AGE, double AT, double ECF, double G, double L,
+                  double F, double BW, double TEI, ModelOutput &out, ModelOutputPartial &part);
+    void   integrateFused(int first, int last, int nsims, const double *TIME,
+                          ModelOutput &out, ModelOutputPartial &part);
+    void   integrateAdaptive(int first, int last, int nsims, const double *TIME,
+                             ModelOutput &out, ModelOutputPartial &part);
+    void   integrateAdaptive(int j, int i0, int nsims, const double *TIME, double AT,
+                             double ECF, double G, double L, double AGE,
+                             ModelOutput &out, ModelOutputPartial &part);
+    void   integrateChunk(int first, int last, int nsims, const double *TIME,
+                          ModelOutput &out, ModelOutputPartial &part);
+    void   settledRows(int first, int last, int nsims, std::vector<int> &settled);
+    void   saveState(int c, int first, int last, const double *state);
+    List   checkpoint(int c, double time);
+    List   sensitivity(std::vector<std::string> vars, int stride, int nsims, std::string summary,
+                       IntegerVector group, NumericVector weights, IntegerVector strata,
+                       List cells, NumericVector TIME, int threads);
+    void   integrateSensitivity(int first, int last, int nsims, const double *TIME,
+                                const std::vector<int> &which, ModelOutput &out,
+                                ModelOutputPartial &part);
+    template <int N>
+    void   integrateSensitivity(int first, int last, int nsims, const double *TIME,
+                                const std::vector<int> &which, ModelOutput &out,
+                                ModelOutputPartial &part);
+    
     
 };
 
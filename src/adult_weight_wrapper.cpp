@@ -10,9 +10,12 @@
 //  ht              .-  Height (m).
 //  age             .-  Years since individual first arrived to Earth.
 //  sex             .-  Either 1 = "female" or 0 = "male".
-//  EIchange        .-  Change in energy intake (kcal).
-//  NAchange        .-  Change in sodium consumption (mg).
-//  PAL             .-  Physical activity level. (Between 1.4 and 2.4)
+//  EIchange        .-  Change in energy intake (kcal). Matrix of nind x days.
+//  NAchange        .-  Change in sodium consumption (mg). Matrix of nind x days.
+//  PAL             .-  Physical activity level. (Between 1.4 and 2.4) Matrix of nind x days.
+//                      EIchange, NAchange and PAL may have a single row (the same for
+//                      every individual) or a single column (the same every day) and
+//                      are read without being expanded (see input_view.h).
 //  pcarb           .-  Proportion of carbohydrates from diet throughout the time the model runs.
 //  pcarb_baseline  .-  Proportion of carbohydrates from diet at baseline.
 //  dt              .-  Time step used to solve the ODE system numerically.
@@ -21,6 +24,19 @@
 //  isEnergy        .-  Boolean to determine if energy intake at baseline is given
 //  input_EI        .-  Energy intake (kcal). 
 //  input_fat       .-  Fat Mass (kg) of the individual.
+//  threads         .-  Number of threads used to integrate the individuals.
+//  output          .-  List with the output requested (see Adult::rk4_fused):
+//                      vars, stride, summary, group, weights, strata and categories.
+//  knots           .-  List with the knots (energy, time and interpolation) used instead
+//                      of EIchange and (or) NAchange (see Adult::setKnots).
+//  solver          .-  List with the integration method ("RK4" or "RK45") and the
+//                      tolerance of the adaptive method (see Adult::setSolver).
+//  nscenarios      .-  Number of scenarios of each individual. The EIchange, NAchange
+//                      and PAL of adult_weight_scenarios_wrapper are (nind x nscenarios)
+//                      x days matrices with the scenarios of individual j in rows
+//                      j*nscenarios, ..., j*nscenarios + nscenarios - 1 and PAL_base
+//                      is the (common) physical activity at baseline (see
+//                      Adult::setScenarios).
 //
 //  Authors:
 //  Dalia Camacho-García-Formentí
@@ -64,19 +80,32 @@
 
 #include <Rcpp.h>
 #include "adult_weight.h"
+#include "profile.h"
 
 // [[Rcpp::export]]
 List adult_weight_wrapper(NumericVector bw, NumericVector ht, NumericVector age,
                           NumericVector sex, NumericMatrix EIchange,
                           NumericMatrix NAchange, NumericMatrix PAL,
                           NumericVector pcarb_base, NumericVector pcarb, double dt,
-                          double days, bool checkValues){
+                          double days, bool checkValues, int threads, List output, List knots,
+                          List solver, List checkpoints){
+    
+    BW_PROFILE_START(threads, "build");
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Intake changes given by their knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //States saved (or resumed from) by the run
+    Person.setCheckpoints(checkpoints);
+    
+    //Run model using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
     
 }
 
@@ -85,13 +114,26 @@ List adult_weight_wrapper_EI(NumericVector bw, NumericVector ht, NumericVector a
                           NumericVector sex, NumericMatrix EIchange,
                           NumericMatrix NAchange, NumericMatrix PAL,
                           NumericVector pcarb_base, NumericVector pcarb, double dt,
-                             NumericVector extradata, double days, bool checkValues, bool isEnergy){
+                             NumericVector extradata, double days, bool checkValues, bool isEnergy,
+                             int threads, List output, List knots,
+                          List solver, List checkpoints){
+    
+    BW_PROFILE_START(threads, "build");
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, extradata, checkValues, isEnergy);
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Intake changes given by their knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //States saved (or resumed from) by the run
+    Person.setCheckpoints(checkpoints);
+    
+    //Run model using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
     
 }
 
@@ -101,12 +143,90 @@ List adult_weight_wrapper_EI_fat(NumericVector bw, NumericVector ht, NumericVect
                              NumericMatrix NAchange, NumericMatrix PAL,
                              NumericVector pcarb_base, NumericVector pcarb, double dt,
                              NumericVector input_EI, NumericVector input_fat,
-                                 double days, bool checkValues){
+                                 double days, bool checkValues, int threads, List output, List knots,
+                          List solver, List checkpoints){
+    
+    BW_PROFILE_START(threads, "build");
     
     //Create new adult with characteristics
     Adult Person (bw,  ht, age, sex, EIchange, NAchange, PAL, pcarb,  pcarb_base, dt, input_EI, input_fat, checkValues);
     
-    //Run model using RK4
-    return Person.rk4(days);
+    //Intake changes given by their knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //States saved (or resumed from) by the run
+    Person.setCheckpoints(checkpoints);
+    
+    //Run model using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
+    
+}
+
+// [[Rcpp::export]]
+List adult_weight_scenarios_wrapper(NumericVector bw, NumericVector ht, NumericVector age,
+                                    NumericVector sex, NumericMatrix PAL_base,
+                                    NumericVector pcarb_base, NumericVector pcarb, double dt,
+                                    NumericVector input_EI, NumericVector input_fat,
+                                    int nscenarios, NumericMatrix EIchange,
+                                    NumericMatrix NAchange, NumericMatrix PAL,
+                                    double days, bool checkValues, int threads, List output,
+                                    List knots, List solver){
+    
+    BW_PROFILE_START(threads, "build");
+    
+    //Create the baseline of each adult only once (the intake changes are not used by it)
+    Adult Person = input_EI.size() > 0 && input_fat.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL_base, pcarb, pcarb_base, dt, input_EI, input_fat, checkValues) :
+        input_EI.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL_base, pcarb, pcarb_base, dt, input_EI, checkValues, true) :
+        input_fat.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL_base, pcarb, pcarb_base, dt, input_fat, checkValues, false) :
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL_base, pcarb, pcarb_base, dt, checkValues);
+    
+    //Every scenario starts from that baseline
+    Person.setScenarios(nscenarios, EIchange, NAchange, PAL);
+    
+    //Intake changes given by their knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //Run all scenarios together using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
+    
+}
+
+// [[Rcpp::export]]
+List adult_weight_target_wrapper(NumericVector bw, NumericVector ht, NumericVector age,
+                                 NumericVector sex, NumericMatrix EIchange,
+                                 NumericMatrix NAchange, NumericMatrix PAL,
+                                 NumericVector pcarb_base, NumericVector pcarb, double dt,
+                                 NumericVector input_EI, NumericVector input_fat,
+                                 double days, bool checkValues, int threads, List target,
+                                 List knots, List solver){
+    
+    BW_PROFILE_START(threads, "build");
+    
+    //Create new adult with characteristics (its baseline is shared by every iteration)
+    Adult Person = input_EI.size() > 0 && input_fat.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb, pcarb_base, dt, input_EI, input_fat, checkValues) :
+        input_EI.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb, pcarb_base, dt, input_EI, checkValues, true) :
+        input_fat.size() > 0 ?
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb, pcarb_base, dt, input_fat, checkValues, false) :
+        Adult(bw, ht, age, sex, EIchange, NAchange, PAL, pcarb, pcarb_base, dt, checkValues);
+    
+    //Intake changes given by their knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //Solve the change of every adult together
+    List results = Person.target(days, threads, target);
+    BW_PROFILE_ATTACH(results);
+    return results;
     
 }
@@ -11,7 +11,8 @@
 //  sex             .-  Either 1 = "female" or 0 = "male"
 //  FFM             .-  Fat Free Mass (kg) of the individual
 //  FM              .-  Fat Mass (kg) of the individual
-//  input_EIntake   .-  Energy intake (kcal) of individual per day
+//  input_EIntake   .-  Energy intake (kcal) of individual per day (a row per day and a
+//                      column per individual; either may be a single one, see InputView)
 //  days            .-  Days to model (integer)
 //  dt              .-  Time step used to solve the ODE system numerically
 //  K               .-  Richardson parameter
@@ -71,6 +72,38 @@
 
 
 #include "child_weight.h"
+#include "child_reference.h"
+#include "vector_math.h"
+#include "dual_number.h"
+#include "lifecourse.h"
+#include "profile.h"
+#include <map>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Individuals integrated together by a thread in the fused engine
+static const int chunk_size = 256;
+
+//Largest table of buildTables (in doubles, 64 MB)
+static const double max_table = 8388608.0;
+
+//Variables returned by the fused engine (in output order)
+enum ChildVariable {OUT_AGE, OUT_FFM, OUT_FM, OUT_BW};
+static const int nchild_variables = OUT_BW + 1;
+static const char *child_variables[] = {"Age", "Fat_Free_Mass", "Fat_Mass", "Body_Weight"};
+
+//Constants whose sensitivities (derivatives of the body weight) rk4_fused can return
+enum ChildParameter {SENS_K, SENS_DELTAMAX};
+static const int nchild_parameters = SENS_DELTAMAX + 1;
+static const char *child_parameters[] = {"K", "deltamax"};
+
+//The state of a child is valid while FFM and FM are positive and finite (the
+//bounds checked by vflag in integrateFused)
+static inline bool validMass(double FFM, double FM){
+    return std::isfinite(FFM) && std::isfinite(FM) && FFM > 0 && FM > 0;
+}
 
 //Default (classic) constructor for energy matrix
 Child::Child(NumericVector input_age, NumericVector input_sex, NumericVector input_bmiCat, NumericVector input_FFM, NumericVector input_FM, NumericMatrix input_EIntake,
@@ -116,7 +149,9 @@ Child::~Child(void){
 }
 
 void Child::build(){
+    age_base = age;
     getParameters();
+    getConstants();
 }
 
 //General function for expressing growth and eb terms
@@ -157,150 +192,33 @@ NumericVector Child::Delta(NumericVector t){
     return deltamin + (deltamax - deltamin)*(1.0 / (1.0 + pow((t / P),h)));
 }
 
-NumericVector Child::FFMReference(NumericVector t){ 
-  /*  return ffm_beta0 + ffm_beta1*t; */
-NumericVector under = ifelse(bmiCat == 1, 1.0, 0.0);
-NumericVector normales = ifelse(bmiCat == 2, 1.0, 0.0);
-NumericVector over = ifelse(bmiCat == 3, 1.0, 0.0);
-NumericVector obese = ifelse(bmiCat == 4, 1.0, 0.0);
-
-NumericMatrix ffm_ref(17,nind);
-  if(referenceValues == 0){
-  // -------------------------- Mean values
-ffm_ref(0,_)   = 10.134*(1-sex)+9.477*sex;       // 2 years old
-ffm_ref(1,_)   = 12.099*(1 - sex) + 11.494*sex;    // 3 years old
-ffm_ref(2,_)   = 14.0*(1 - sex) + 13.2*sex;        // 4 years old
-ffm_ref(3,_)   = 15.72*(1 - sex) + 14.86*sex;      // 5 years old
-ffm_ref(4,_)   = under*(12.7942*(1-sex) + 13.7957*sex) + normales*(17.0238*(1-sex) + 15.2337*sex) + over*(19.3070*(1-sex) + 17.7866*sex) + obese*(22.2248*(1-sex) + 21.2170*sex);   // 6 years old
-ffm_ref(5,_)   = under*(17.8106*(1-sex) + 18.4835*sex) + normales*(19.0775*(1-sex) + 17.5198*sex) + over*(20.3344*(1-sex) + 18.9406*sex) + obese*(23.1765*(1-sex) + 22.2733*sex);   // 7 years old
-ffm_ref(6,_)   = under*(20.3597*(1-sex) + 18.5363*sex) + normales*(20.4774*(1-sex) + 19.6317*sex) + over*(22.1128*(1-sex) + 21.6080*sex) + obese*(25.8151*(1-sex) + 25.1641*sex);   // 8 years old
-ffm_ref(7,_)   = under*(19.3668*(1-sex) + 17.0314*sex) + normales*(22.3768*(1-sex) + 21.3680*sex) + over*(26.7714*(1-sex) + 26.1791*sex) + obese*(31.3143*(1-sex) + 30.1484*sex);   // 9 years old
-ffm_ref(8,_)   = under*(23.9096*(1-sex) + 19.1085*sex) + normales*(24.8998*(1-sex) + 24.0922*sex) + over*(30.4866*(1-sex) + 30.3541*sex) + obese*(34.1717*(1-sex) + 35.2838*sex);   // 10 years old
-ffm_ref(9,_)   = under*(23.5033*(1-sex) + 23.3318*sex) + normales*(27.5943*(1-sex) + 28.2737*sex) + over*(32.6556*(1-sex) + 34.1915*sex) + obese*(38.2638*(1-sex) + 37.0428*sex);   // 11 years old
-ffm_ref(10,_)   = under*(24.7662*(1-sex) + 25.9357*sex) + normales*(31.5163*(1-sex) + 31.9490*sex) + over*(37.5262*(1-sex) + 37.0654*sex) + obese*(42.3513*(1-sex) + 42.5446*sex);   // 12 years old
-ffm_ref(11,_)   = under*(28.9497*(1-sex) + 30.2351*sex) + normales*(36.3432*(1-sex) + 34.3348*sex) + over*(41.6549*(1-sex) + 39.1559*sex) + obese*(48.1398*(1-sex) + 44.0205*sex);   // 13 years old
-ffm_ref(12,_)   = under*(33.9297*(1-sex) + 33.6380*sex) + normales*(40.9730*(1-sex) + 36.1797*sex) + over*(48.0671*(1-sex) + 40.9960*sex) + obese*(50.1084*(1-sex) + 46.0726*sex);   // 14 years old
-ffm_ref(13,_)   = under*(35.2601*(1-sex) + 33.0539*sex) + normales*(43.7795*(1-sex) + 38.1065*sex) + over*(49.3493*(1-sex) + 42.8965*sex) + obese*(55.6289*(1-sex) + 48.6841*sex);   // 15 years old
-ffm_ref(14,_)   = under*(40.5041*(1-sex) + 32.9676*sex) + normales*(46.9540*(1-sex) + 40.1114*sex) + over*(52.9435*(1-sex) + 45.6216*sex) + obese*(58.9917*(1-sex) + 49.7917*sex);   // 16 years old
-ffm_ref(15,_)   = under*(42.0445*(1-sex) + 32.3827*sex) + normales*(47.8972*(1-sex) + 39.6064*sex) + over*(55.8888*(1-sex) + 46.1784*sex) + obese*(58.7117*(1-sex) + 51.0534*sex);   // 17 years old
-ffm_ref(16,_)   = under*(44.0779*(1-sex) + 35.5248*sex) + normales*(49.6930*(1-sex) + 41.2798*sex) + over*(56.5725*(1-sex) + 45.9979*sex) + obese*(61.7620*(1-sex) + 49.8746*sex);   // 18 years old
-
-  }
-
-
-  if(referenceValues == 1){
-    // -------------------------- Median values
-ffm_ref(0,_)   = 10.134*(1-sex)+9.477*sex;       // 2 years old
-ffm_ref(1,_)   = 12.099*(1 - sex) + 11.494*sex;    // 3 years old
-ffm_ref(2,_)   = 14.0*(1 - sex) + 13.2*sex;        // 4 years old
-ffm_ref(3,_)   = 15.72*(1 - sex) + 14.86*sex;      // 5 years old
-ffm_ref(4,_)   = under*(14.4641*(1-sex) + 13.8627*sex) + normales*(17.1430*(1-sex) + 15.1282*sex) + over*(19.2280*(1-sex) + 17.6859*sex) + obese*(21.9501*(1-sex) + 20.4992*sex);   // 6 years old
-ffm_ref(5,_)   = under*(16.3729*(1-sex) + 16.6347*sex) + normales*(18.2285*(1-sex) + 17.2507*sex) + over*(21.7099*(1-sex) + 20.0341*sex) + obese*(24.9713*(1-sex) + 23.4162*sex);   // 7 years old
-ffm_ref(6,_)   = under*(18.0019*(1-sex) + 17.2583*sex) + normales*(19.9148*(1-sex) + 19.4286*sex) + over*(24.6404*(1-sex) + 22.1758*sex) + obese*(27.4774*(1-sex) + 26.8346*sex);   // 8 years old
-ffm_ref(7,_)   = under*(19.2548*(1-sex) + 17.5150*sex) + normales*(21.9058*(1-sex) + 21.2721*sex) + over*(26.5243*(1-sex) + 25.6952*sex) + obese*(30.8636*(1-sex) + 29.2900*sex);   // 9 years old
-ffm_ref(8,_)   = under*(23.9096*(1-sex) + 20.1493*sex) + normales*(24.8603*(1-sex) + 23.6199*sex) + over*(29.9298*(1-sex) + 29.5716*sex) + obese*(34.1859*(1-sex) + 34.1346*sex);   // 10 years old
-ffm_ref(9,_)   = under*(23.7557*(1-sex) + 24.0089*sex) + normales*(27.4756*(1-sex) + 28.2708*sex) + over*(32.4980*(1-sex) + 32.8672*sex) + obese*(38.1778*(1-sex) + 37.5833*sex);   // 11 years old
-ffm_ref(10,_)   = under*(24.1310*(1-sex) + 25.5209*sex) + normales*(31.2494*(1-sex) + 32.2679*sex) + over*(37.7967*(1-sex) + 36.7435*sex) + obese*(42.8213*(1-sex) + 42.2971*sex);   // 12 years old
-ffm_ref(11,_)   = under*(28.2941*(1-sex) + 32.6849*sex) + normales*(36.0685*(1-sex) + 33.7855*sex) + over*(41.4671*(1-sex) + 38.6218*sex) + obese*(48.1462*(1-sex) + 43.5195*sex);   // 13 years old
-ffm_ref(12,_)   = under*(33.7396*(1-sex) + 37.2420*sex) + normales*(40.9866*(1-sex) + 35.9762*sex) + over*(47.9945*(1-sex) + 40.9744*sex) + obese*(50.9872*(1-sex) + 45.6421*sex);   // 14 years old
-ffm_ref(13,_)   = under*(35.7472*(1-sex) + 32.2773*sex) + normales*(44.0430*(1-sex) + 38.2639*sex) + over*(49.7454*(1-sex) + 43.1117*sex) + obese*(54.9071*(1-sex) + 48.1360*sex);   // 15 years old
-ffm_ref(14,_)   = under*(41.8846*(1-sex) + 33.0258*sex) + normales*(46.8444*(1-sex) + 39.6752*sex) + over*(53.3482*(1-sex) + 45.7056*sex) + obese*(58.5851*(1-sex) + 48.9594*sex);   // 16 years old
-ffm_ref(15,_)   = under*(42.6661*(1-sex) + 31.6275*sex) + normales*(48.2625*(1-sex) + 39.5399*sex) + over*(55.9614*(1-sex) + 47.2530*sex) + obese*(58.4194*(1-sex) + 50.7464*sex);   // 17 years old
-ffm_ref(16,_)   = under*(42.8578*(1-sex) + 37.5435*sex) + normales*(49.4174*(1-sex) + 41.5349*sex) + over*(56.7387*(1-sex) + 45.9623*sex) + obese*(63.6968*(1-sex) + 50.0229*sex);   // 18 years old
-  }
-
-NumericVector ffm_ref_t(nind);
-int jmin;
-int jmax;
-double diff;
-for(int i=0;i<nind;i++){
-  if(t(i)>=18.0){
-    ffm_ref_t(i)=ffm_ref(16,i);
-  }else{
-    jmin=floor(t(i));
-    jmin=std::max(jmin,2);
-    jmin=jmin-2;
-    jmax= std::min(jmin+1,17);
-    diff= t(i)-floor(t(i));
-    ffm_ref_t(i)=ffm_ref(jmin,i)+diff*(ffm_ref(jmax,i)-ffm_ref(jmin,i));
-  } 
-}
-return ffm_ref_t;
+//Linear interpolation of a reference table from 2 to 18 years
+static double interpolateReference(const double *ref, double t){
+    if(t>=18.0){
+        return ref[16];
+    }
+    int jmin = floor(t);
+    jmin     = std::max(jmin,2);
+    jmin     = jmin-2;
+    int jmax = std::min(jmin+1,17);
+    double diff = t-floor(t);
+    return ref[jmin]+diff*(ref[jmax]-ref[jmin]);
+}
+
+NumericVector Child::FFMReference(NumericVector t){
+    NumericVector ffm_ref_t(nind);
+    for(int i=0;i<nind;i++){
+        ffm_ref_t(i) = interpolateReference(constants[i].ffm_ref, t(i));
+    }
+    return ffm_ref_t;
 }
 
 NumericVector Child::FMReference(NumericVector t){
-   /* return fm_beta0 + fm_beta1*t;*/
-NumericVector under = ifelse(bmiCat == 1, 1.0, 0.0);
-NumericVector normales = ifelse(bmiCat == 2, 1.0, 0.0);
-NumericVector over = ifelse(bmiCat == 3, 1.0, 0.0);
-NumericVector obese = ifelse(bmiCat == 4, 1.0, 0.0);
-
-NumericMatrix fm_ref(17,nind);
- if(referenceValues == 0){
-  // ---------------------------------------- Mean values
-
-fm_ref(0,_)   = 2.456*(1-sex)+ 2.433*sex;       // 2 years old
-fm_ref(1,_)   = 2.576*(1 - sex) + 2.606*sex;    // 3 years old
-fm_ref(2,_)   = 2.7*(1 - sex) + 2.8*sex;        // 4 years old
-fm_ref(3,_)   = 3.66*(1 - sex) + 4.47*sex;      // 5 years old
-fm_ref(4,_)   = under*(1.7764*(1-sex) + 2.5951*sex) + normales*(3.4540*(1-sex) + 3.8303*sex) + over*(4.8055*(1-sex) + 5.7014*sex) + obese*(7.9672*(1-sex) + 9.3883*sex);   // 6 years old
-fm_ref(5,_)   = under*(2.3398*(1-sex) + 2.8164*sex) + normales*(3.5859*(1-sex) + 4.2782*sex) + over*(5.4625*(1-sex) + 6.5960*sex) + obese*( 8.4350*(1-sex) + 10.4148*sex);   // 7 years old
-fm_ref(6,_)   = under*(3.2767*(1-sex) + 3.0828*sex) + normales*(4.1138*(1-sex) + 5.2226*sex) + over*(5.5455*(1-sex) + 7.3667*sex) + obese*( 9.3266*(1-sex) + 12.0550*sex);   // 8 years old
-fm_ref(7,_)   = under*(2.3902*(1-sex) + 2.6538*sex) + normales*(4.1705*(1-sex) + 5.0218*sex) + over*(6.6958*(1-sex) + 8.6945*sex) + obese*(11.5896*(1-sex) + 14.1436*sex);   // 9 years old
-fm_ref(8,_)   = under*(2.9954*(1-sex) + 3.1389*sex) + normales*(4.5465*(1-sex) + 5.7742*sex) + over*( 8.1191*(1-sex) + 10.6667*sex) + obese*(13.4114*(1-sex) + 17.3329*sex);   // 10 years old
-fm_ref(9,_)   = under*(2.6803*(1-sex) + 3.8049*sex) + normales*(5.0225*(1-sex) + 6.9162*sex) + over*( 8.7335*(1-sex) + 12.3291*sex) + obese*(15.2821*(1-sex) + 19.0058*sex);   // 11 years old
-fm_ref(10,_)   = under*(2.8835*(1-sex) + 4.2002*sex) + normales*(5.9324*(1-sex) + 8.2706*sex) + over*(10.5608*(1-sex) + 14.4379*sex) + obese*(18.3024*(1-sex) + 24.9390*sex);   // 12 years old
-fm_ref(11,_)   = under*(3.1579*(1-sex) + 4.7942*sex) + normales*(7.0763*(1-sex) + 9.1606*sex) + over*(12.3945*(1-sex) + 15.0401*sex) + obese*(21.7342*(1-sex) + 28.2547*sex);   // 13 years old
-fm_ref(12,_)   = under*(3.6857*(1-sex) + 5.3309*sex) + normales*( 8.3966*(1-sex) + 10.0249*sex) + over*(15.0498*(1-sex) + 17.1050*sex) + obese*(24.2628*(1-sex) + 29.7700*sex);   // 14 years old
-fm_ref(13,_)   = under*(3.9803*(1-sex) + 5.2442*sex) + normales*( 9.0181*(1-sex) + 10.5653*sex) + over*(15.5611*(1-sex) + 17.5730*sex) + obese*(27.0142*(1-sex) + 29.9077*sex);   // 15 years old
-fm_ref(14,_)   = under*(4.6019*(1-sex) + 4.8228*sex) + normales*(10.0921*(1-sex) + 11.4444*sex) + over*(18.1619*(1-sex) + 19.9088*sex) + obese*(30.8170*(1-sex) + 31.2351*sex);   // 16 years old
-fm_ref(15,_)   = under*(4.8405*(1-sex) + 4.8583*sex) + normales*(10.0547*(1-sex) + 10.6654*sex) + over*(19.2423*(1-sex) + 19.4731*sex) + obese*(30.7942*(1-sex) + 31.1807*sex);   // 17 years old
-fm_ref(16,_)   = under*(4.6858*(1-sex) + 5.3332*sex) + normales*(10.7726*(1-sex) + 11.3437*sex) + over*(19.1356*(1-sex) + 19.0598*sex) + obese*(35.6945*(1-sex) + 30.3288*sex);   // 18 years old
-
- }
-
- if(referenceValues == 1){
-  // ---------------------------------------- Median values
-
-fm_ref(0,_)   = 2.456*(1-sex)+ 2.433*sex;       // 2 years old
-fm_ref(1,_)   = 2.576*(1 - sex) + 2.606*sex;    // 3 years old
-fm_ref(2,_)   = 2.7*(1 - sex) + 2.8*sex;        // 4 years old
-fm_ref(3,_)   = 3.66*(1 - sex) + 4.47*sex;      // 5 years old
-fm_ref(4,_)   = under*(2.0359*(1-sex) + 2.5660*sex) + normales*(3.4642*(1-sex) + 3.7042*sex) + over*(4.6220*(1-sex) + 5.6735*sex) + obese*(7.1058*(1-sex) + 8.7339*sex);   // 6 years old
-fm_ref(5,_)   = under*(2.3771*(1-sex) + 2.9560*sex) + normales*(3.6030*(1-sex) + 4.1865*sex) + over*(5.5651*(1-sex) + 6.4374*sex) + obese*(8.0501*(1-sex) + 9.3100*sex);   // 7 years old
-fm_ref(6,_)   = under*(2.1231*(1-sex) + 3.0917*sex) + normales*(3.6729*(1-sex) + 4.8531*sex) + over*(5.8971*(1-sex) + 7.0172*sex) + obese*( 8.9372*(1-sex) + 11.5469*sex);   // 8 years old
-fm_ref(7,_)   = under*(2.4068*(1-sex) + 2.9027*sex) + normales*(4.0597*(1-sex) + 4.8707*sex) + over*(6.5720*(1-sex) + 8.7112*sex) + obese*(10.8084*(1-sex) + 12.7559*sex);   // 9 years old
-fm_ref(8,_)   = under*(2.9954*(1-sex) + 3.1757*sex) + normales*(4.5932*(1-sex) + 5.4455*sex) + over*( 8.0701*(1-sex) + 10.6143*sex) + obese*(12.3133*(1-sex) + 15.7121*sex);   // 10 years old
-fm_ref(9,_)   = under*(2.7443*(1-sex) + 3.8911*sex) + normales*(4.7619*(1-sex) + 6.9604*sex) + over*( 8.6445*(1-sex) + 11.7518*sex) + obese*(14.4743*(1-sex) + 17.4123*sex);   // 11 years old
-fm_ref(10,_)   = under*(2.8190*(1-sex) + 4.1099*sex) + normales*(5.5671*(1-sex) + 8.3722*sex) + over*(10.2431*(1-sex) + 14.7437*sex) + obese*(17.3155*(1-sex) + 22.9359*sex);   // 12 years old
-fm_ref(11,_)   = under*(3.0059*(1-sex) + 5.3651*sex) + normales*(6.7689*(1-sex) + 9.2549*sex) + over*(12.0232*(1-sex) + 14.6163*sex) + obese*(21.0382*(1-sex) + 26.6716*sex);   // 13 years old
-fm_ref(12,_)   = under*(3.7104*(1-sex) + 5.8580*sex) + normales*(8.4317*(1-sex) + 9.8827*sex) + over*(15.2507*(1-sex) + 16.2256*sex) + obese*(22.9540*(1-sex) + 27.6643*sex);   // 14 years old
-fm_ref(13,_)   = under*(4.4546*(1-sex) + 5.2493*sex) + normales*( 8.7820*(1-sex) + 10.3785*sex) + over*(15.6754*(1-sex) + 17.3977*sex) + obese*(25.5113*(1-sex) + 28.0559*sex);   // 15 years old
-fm_ref(14,_)   = under*(4.6585*(1-sex) + 4.8742*sex) + normales*( 9.5728*(1-sex) + 11.4776*sex) + over*(18.3549*(1-sex) + 19.7533*sex) + obese*(29.9916*(1-sex) + 30.6943*sex);   // 16 years old
-fm_ref(15,_)   = under*(4.8189*(1-sex) + 4.7975*sex) + normales*(10.3426*(1-sex) + 10.3454*sex) + over*(18.9543*(1-sex) + 19.3869*sex) + obese*(27.2116*(1-sex) + 29.9799*sex);   // 17 years old
-fm_ref(16,_)   = under*(4.5259*(1-sex) + 5.7815*sex) + normales*(10.7497*(1-sex) + 10.9042*sex) + over*(18.9053*(1-sex) + 19.1592*sex) + obese*(31.9253*(1-sex) + 28.3702*sex);   // 18 years old
- }
-
-
-
-  
-NumericVector fm_ref_t(nind);
-int jmin;
-int jmax;
-double diff;
-for(int i=0;i<nind;i++){
-  if(t(i)>=18.0){
-    fm_ref_t(i)=fm_ref(16,i);
-  }else{
-    jmin=floor(t(i));
-    jmin=std::max(jmin,2);
-    jmin=jmin-2;
-    jmax= std::min(jmin+1,17);
-    diff= t(i)-floor(t(i));
-    fm_ref_t(i)=fm_ref(jmin,i)+diff*(fm_ref(jmax,i)-fm_ref(jmin,i));
-  } 
-}
-return fm_ref_t;
+    NumericVector fm_ref_t(nind);
+    for(int i=0;i<nind;i++){
+        fm_ref_t(i) = interpolateReference(constants[i].fm_ref, t(i));
+    }
+    return fm_ref_t;
 }
 
 NumericVector Child::IntakeReference(NumericVector t){
@@ -411,10 +329,28 @@ void Child::getParameters(void){
     P        = 12.0;
     h        = 10.0;
     
+    //Fixed step RK4 unless setSolver says otherwise
+    adaptive  = false;
+    tolerance = 1e-6;
+    tables    = true;
+    halt      = false;
+    
+    //Outputs in double unless setStorage says otherwise
+    precision  = "double";
+    resolution = List();
+    path       = "";
+    
+    //Integration starts at baseline unless setCheckpoints resumes a run
+    step0    = 0;
+    
     //Number of individuals
     nind     = age.size();
     
-    //Sex specific constants
+    getSexConstants();
+}
+
+//Sex specific constants
+void Child::getSexConstants(void){
     ffm_beta0 = 2.9*(1 - sex)  + 3.8*sex;
     ffm_beta1 = 2.9*(1 - sex)  + 2.3*sex;
     fm_beta0  = 1.2*(1 - sex)  + 0.56*sex;
@@ -457,7 +393,943 @@ NumericVector Child::Intake(NumericVector t){
         return A_logistic + (K_logistic - A_logistic)/pow(C_logistic + Q_logistic*exp(-B_logistic*t), 1/nu_logistic); //t in years
     } else {
         int timeval = floor(365.0*(t(0) - age(0))/dt); //Example: Age: 6 and t: 7.1 => timeval = 401 which corresponds to the 401 entry of matrix
-        return EIntake(timeval,_);
+        if (EIknots.active){
+            NumericVector intake(nind);
+            for (int j = 0; j < nind; j++){
+                intake(j) = EIknots.value(timeval + 1, j);
+            }
+            return intake;
+        }
+        return EIview.values(timeval, nind);
+    }
+    
+}
+
+
+
+//Copy the constants of each child into plain storage so that the fused engine
+//never touches Rcpp objects while integrating
+void Child::getConstants(void){
+    
+    //Reference tables (mean or median) of every child are resolved once from
+    //its sex and BMI category
+    const int type = (referenceValues == 1) ? 1 : 0;
+    
+    constants.resize(nind);
+    for (int j = 0; j < nind; j++){
+        const int sexval = (sex(j) == 1) ? 1 : 0;
+        const int cat    = bmiCat(j) - 1;
+        if (cat < 0 || cat > 3){
+            stop("Invalid bmi category value (bmiCat). Please specify 1 for underweight, 2 for normal weight, 3 for overweight, or 4 for obesity.");
+        }
+        
+        ChildConstants &q = constants[j];
+        q.K        = K(j);
+        q.deltamax = deltamax(j);
+        q.growth   = {A(j), B(j), D(j), tA(j), tB(j), tD(j), tauA(j), tauB(j), tauD(j)};
+        q.eb       = {A_EB(j), B_EB(j), D_EB(j), tA_EB(j), tB_EB(j), tD_EB(j),
+                      tauA_EB(j), tauB_EB(j), tauD_EB(j)};
+        q.ffm_ref  = ffm_reference[type][sexval][cat];
+        q.fm_ref   = fm_reference[type][sexval][cat];
+    }
+    
+    EIview = InputView(EIntake, false);
+}
+
+//Knots of the energy intake. knots may have an element EI with the energy, time
+//and interpolation of energy_build. As in Adult::setKnots, day i + 1 of the knots
+//is used for row i of EIntake so results are the same as running the model with
+//the transpose of the matrix built by energy_build.
+void Child::setKnots(List knots){
+    if (knots.containsElementNamed("EI")){
+        EIknots = EnergyKnots(as<List>(knots["EI"]));
+    }
+}
+
+//Integration method of rk4_fused. solver is a list with the method ("RK4" or
+//"RK45"), the tolerance of the adaptive method and optionally whether the terms
+//of each cohort are precomputed (tables, see buildTables) and whether children
+//whose state is invalid stop (halt, with checkValues) reporting NA from then on.
+void Child::setSolver(List solver){
+    adaptive  = as<std::string>(solver["method"]) == "RK45";
+    tolerance = as<double>(solver["tolerance"]);
+    tables    = solver.containsElementNamed("tables") ? as<bool>(solver["tables"]) : true;
+    halt      = solver.containsElementNamed("halt") && as<bool>(solver["halt"]);
+}
+
+//Storage of the outputs of rk4_fused. storage is a list with the precision
+//("double", "float", "int32" or "int16"), a named list with the resolution
+//of each variable for the fixed point precisions (see OutputStore) and
+//optionally the directory path where each output is written as <variable>.bin
+//and the constants (sensitivity) whose sensitivities are returned.
+void Child::setStorage(List storage){
+    precision  = as<std::string>(storage["precision"]);
+    resolution = as<List>(storage["resolution"]);
+    path       = storage.containsElementNamed("path") ? as<std::string>(storage["path"]) : "";
+    getPrecision(precision);
+    
+    sensitivities.clear();
+    if (storage.containsElementNamed("sensitivity")){
+        sensitivities = as< std::vector<std::string> >(storage["sensitivity"]);
+    }
+    for (std::size_t k = 0; k < sensitivities.size(); k++){
+        if (std::find(child_parameters, child_parameters + nchild_parameters, sensitivities[k]) ==
+            child_parameters + nchild_parameters){
+            stop("Invalid sensitivity. Please specify any of: 'K', 'deltamax'.");
+        }
+    }
+}
+
+//Checkpoints of rk4_fused as in Adult::setCheckpoints. checkpoints is a list with
+//the time steps (steps) at which the age, FFM and FM of every child are saved and
+//optionally a checkpoint (resume) of a previous run of the same children to
+//start from. A checkpoint has the time step and time at which it was taken, dt,
+//the state and the constants of the children (age at baseline, sex, bmiCat and
+//referenceValues, which give the rest). The rows of EIntake are still those of
+//the time since baseline.
+void Child::setCheckpoints(List checkpoints){
+    
+    checkpoint_steps = as< std::vector<int> >(checkpoints["steps"]);
+    if (!checkpoints.containsElementNamed("resume")){
+        return;
+    }
+    
+    List resume    = as<List>(checkpoints["resume"]);
+    List state     = as<List>(resume["state"]);
+    List constants = as<List>(resume["constants"]);
+    if (as<std::string>(resume["Model_Type"]) != "Children" || as<double>(resume["dt"]) != dt ||
+        as<NumericVector>(constants["age"]).size() != nind){
+        stop("Invalid resume. The checkpoint must come from a run of the same children with the same dt.");
+    }
+    
+    //Constants of the run that saved the checkpoint
+    age_base        = as<NumericVector>(constants["age"]);
+    sex             = as<NumericVector>(constants["sex"]);
+    bmiCat          = as<NumericVector>(constants["bmiCat"]);
+    referenceValues = as<double>(constants["referenceValues"]);
+    getSexConstants();
+    getConstants();
+    
+    //State at the time step of the checkpoint (the integrators start from it)
+    step0 = as<int>(resume["step"]);
+    age   = as<NumericVector>(state["Age"]);
+    FFM   = as<NumericVector>(state["Fat_Free_Mass"]);
+    FM    = as<NumericVector>(state["Fat_Mass"]);
+}
+
+//Checkpoint c taken at time (see setCheckpoints)
+List Child::checkpoint(int c, double time){
+    
+    //Saved state of each variable
+    List state;
+    for (int v = 0; v < 3; v++){
+        std::vector<double>::const_iterator x = saved.begin() + ((std::size_t) 3*c + v)*nind;
+        state.push_back(NumericVector(x, x + nind), child_variables[v]);
+    }
+    
+    List constants = List::create(Named("age")             = age_base,
+                                  Named("sex")             = sex,
+                                  Named("bmiCat")          = bmiCat,
+                                  Named("referenceValues") = referenceValues);
+    
+    List snapshot = List::create(Named("Model_Type") = "Children",
+                                 Named("step")       = checkpoint_steps[c],
+                                 Named("time")       = time,
+                                 Named("dt")         = dt,
+                                 Named("state")      = state,
+                                 Named("constants")  = constants);
+    snapshot.attr("class") = "bw_checkpoint";
+    return snapshot;
+}
+
+//Scalar functions for the fused engine
+//----------------------------------------------------------------------------------------
+//Each one evaluates the same expression as its NumericVector counterpart above (up to
+//the vexp tolerance of the exponentials of a stage) but for a single child so that no
+//temporary vectors are created.
+
+double Child::general_ode(double t, const ChildTerms &q){
+    return q.A*exp(-(t-q.tA)/q.tauA ) +
+            q.B*exp(-0.5*pow((t-q.tB)/q.tauB,2)) +
+            q.D*exp(-0.5*pow((t-q.tD)/q.tauD,2));
+}
+
+template <typename T>
+T Child::cRhoFFM(const T &input_FFM){
+    return 4.3*input_FFM + 837.0;
+}
+
+template <typename T>
+T Child::cP(const T &FFM, const T &FM){
+    T rhoFFM = cRhoFFM(FFM);
+    T C      = 10.4 * rhoFFM / rhoFM;
+    return C/(C + FM);
+}
+
+template <typename T>
+T Child::Delta(double t, const ChildConstantsOf<T> &q){
+    return deltamin + (q.deltamax - deltamin)*(1.0 / (1.0 + pow((t / P),h)));
+}
+
+template <typename T>
+double Child::FFMReference(double t, const ChildConstantsOf<T> &q){
+    return interpolateReference(q.ffm_ref, t);
+}
+
+template <typename T>
+double Child::FMReference(double t, const ChildConstantsOf<T> &q){
+    return interpolateReference(q.fm_ref, t);
+}
+
+//Reference intake with the terms EB (EB_impact), growth and delta of age t
+template <typename T>
+T Child::IntakeReference(double t, double EB, double growth, const T &delta,
+                         const ChildConstantsOf<T> &q){
+    double FFMref  = FFMReference(t, q);
+    double FMref   = FMReference(t, q);
+    double p       = cP(FFMref, FMref);
+    double rhoFFM  = cRhoFFM(FFMref);
+    return EB + q.K + (22.4 + delta)*FFMref + (4.5 + delta)*FMref +
+                230.0/rhoFFM*(p*EB + growth) + 180.0/rhoFM*((1-p)*EB-growth);
+}
+
+//Intake of child j at age t; row is the row of EIntake used by Intake(t)
+double Child::Intake(double t, int row, int j){
+    if (generalized_logistic) {
+        return logisticIntake(exp(-B_logistic*t)); //t in years
+    } else {
+        if (EIknots.active){
+            return EIknots.value(row + 1, j);
+        }
+        return EIview.value(row, j);
+    }
+}
+
+//Richard's curve given exp(-B t)
+double Child::logisticIntake(double expBt){
+    return A_logistic + (K_logistic - A_logistic)/pow(C_logistic + Q_logistic*expBt, 1/nu_logistic);
+}
+
+//Terms of child j at age t with constants q
+template <typename T>
+void Child::timeTerms(double t, int row, int j, const ChildConstantsOf<T> &q,
+                      ChildTimeTermsOf<T> &c){
+    c.intake = Intake(t, row, j);
+    c.growth = general_ode(t, q.growth);
+    c.delta  = Delta(t, q);
+    c.Iref   = IntakeReference(t, general_ode(t, q.eb), c.growth, c.delta, q);
+}
+
+//Terms of child j at age t
+void Child::timeTerms(double t, int row, int j, ChildTimeTerms &c){
+    timeTerms(t, row, j, constants[j], c);
+}
+
+//Intake sources of the fused engine: each child reads its own row of EIntake (or
+//of its knots) while the Richards curve is evaluated once per age (in curve)
+struct Child::MatrixIntake {
+    static const bool shared = false;
+    static double value(const Child &model, const double *curve, int group, int row, int j){
+        return model.EIview.value(row, j);
+    }
+};
+
+struct Child::KnotsIntake {
+    static const bool shared = false;
+    static double value(const Child &model, const double *curve, int group, int row, int j){
+        return model.EIknots.value(row + 1, j);
+    }
+};
+
+struct Child::LogisticIntake {
+    static const bool shared = true;
+    static double value(const Child &model, const double *curve, int group, int row, int j){
+        return curve[group];
+    }
+};
+
+//Groups of children first, ..., last - 1 by age, and by age and sex (see ChildGroups)
+void Child::groupChildren(int first, int last, ChildGroups &g){
+    std::map<std::pair<double, double>, int> terms;
+    std::map<double, int> ages;
+    g.terms.resize(last - first);
+    g.ages.resize(last - first);
+    g.terms_first.clear();
+    g.terms_child.clear();
+    g.ages_first.clear();
+    for (int j = first; j < last; j++){
+        const int k = j - first;
+        std::pair<std::map<std::pair<double, double>, int>::iterator, bool> t =
+            terms.insert(std::make_pair(std::make_pair(age[j], sex[j]), (int) g.terms_first.size()));
+        if (t.second){
+            g.terms_first.push_back(k);
+        }
+        g.terms[k] = t.first->second;
+        if (t.second){
+            g.terms_child.push_back(j);
+        }
+        std::pair<std::map<double, int>::iterator, bool> a =
+            ages.insert(std::make_pair(age[j], (int) g.ages_first.size()));
+        if (a.second){
+            g.ages_first.push_back(k);
+        }
+        g.ages[k] = a.first->second;
+    }
+}
+
+//Growth_dynamic, EB_impact and Delta of children child[0], ..., child[m - 1] at ages
+//time into x[r], x[m + r] and x[2 m + r]. x has size 6 m as the exponentials of
+//general_ode are evaluated together by vexp.
+void Child::ageTerms(int m, const int *child, const double *time, double *x){
+    for (int r = 0; r < m; r++){
+        const ChildConstants &q = constants[child[r]];
+        x[r]       = -(time[r]-q.growth.tA)/q.growth.tauA;
+        x[m + r]   = -0.5*pow((time[r]-q.growth.tB)/q.growth.tauB,2);
+        x[2*m + r] = -0.5*pow((time[r]-q.growth.tD)/q.growth.tauD,2);
+        x[3*m + r] = -(time[r]-q.eb.tA)/q.eb.tauA;
+        x[4*m + r] = -0.5*pow((time[r]-q.eb.tB)/q.eb.tauB,2);
+        x[5*m + r] = -0.5*pow((time[r]-q.eb.tD)/q.eb.tauD,2);
+    }
+    vexp(x, x, 6*m);
+    for (int r = 0; r < m; r++){
+        const ChildConstants &q = constants[child[r]];
+        const double growth = q.growth.A*x[r] + q.growth.B*x[m + r] + q.growth.D*x[2*m + r];
+        const double EB     = q.eb.A*x[3*m + r] + q.eb.B*x[4*m + r] + q.eb.D*x[5*m + r];
+        x[r]       = growth;
+        x[m + r]   = EB;
+        x[2*m + r] = Delta(time[r], q);
+    }
+}
+
+//Terms of children first, ..., last - 1 at ages t[j - first] + offset into c[j - first].
+//Growth, EB_impact and Delta only depend on age and sex and the Richards curve
+//only on age so they are evaluated once per group of g. work has size 8 (last - first).
+template <class Source>
+void Child::timeTerms(int first, int last, const double *t, double offset, int row,
+                      const ChildGroups &g, ChildTimeTerms *c, double *work){
+    const int m = g.terms_first.size();
+    const int a = Source::shared ? g.ages_first.size() : 0;
+    double *x     = work;
+    double *curve = work + 6*m;
+    double *time  = curve + a;
+    for (int r = 0; r < m; r++){
+        time[r] = t[g.terms_first[r]] + offset;
+    }
+    ageTerms(m, g.terms_child.data(), time, x);
+    for (int r = 0; r < a; r++){
+        curve[r] = -B_logistic*(t[g.ages_first[r]] + offset);
+    }
+    vexp(curve, curve, a);
+    for (int r = 0; r < a; r++){
+        curve[r] = logisticIntake(curve[r]);
+    }
+    
+    for (int j = first; j < last; j++){
+        const ChildConstants &q = constants[j];
+        const int    k    = j - first;
+        const int    r    = g.terms[k];
+        ChildTimeTerms &ck = c[k];
+        ck.intake = Source::value(*this, curve, g.ages[k], row, j);
+        ck.growth = x[r];
+        ck.delta  = x[2*m + r];
+        ck.Iref   = IntakeReference(t[k] + offset, x[m + r], ck.growth, ck.delta, q);
+    }
+}
+
+//Terms of every cohort of children (same age, sex and BMI category) at every
+//stage of the nsims steps of integrateFused: stage 0 is the start and stages
+//2 i - 1 and 2 i the middle and the end of step i. The ages of a cohort follow
+//the same grid so its terms (but the intake of each child) are computed once for
+//the whole run, in the same way as timeTerms. The table is left empty (and the
+//terms are evaluated at each step) if it is disabled by setSolver, the method is
+//adaptive, the cohorts are hardly shared or the table would not fit in max_table.
+void Child::buildTables(int nsims, int threads){
+    
+    table.clear();
+    cohort.assign(nind, 0);
+    nstages = 2*nsims + 1;
+    if (!tables || adaptive || nind == 0){
+        return;
+    }
+    
+    std::map<std::pair<std::pair<double, double>, double>, int> cohorts;
+    std::vector<int> cohort_first;
+    for (int j = 0; j < nind; j++){
+        std::pair<std::map<std::pair<std::pair<double, double>, double>, int>::iterator, bool> c =
+            cohorts.insert(std::make_pair(std::make_pair(std::make_pair(age[j], sex[j]), bmiCat[j]),
+                                          (int) cohort_first.size()));
+        if (c.second){
+            cohort_first.push_back(j);
+        }
+        cohort[j] = c.first->second;
+    }
+    const int ncohorts = cohort_first.size();
+    if (2*ncohorts > nind || (double) ncohorts*nstages*4 > max_table){
+        return;
+    }
+    table.resize((std::size_t) ncohorts*nstages*4);
+    BW_PROFILE_BYTES(table.size()*sizeof(double));
+    
+    //Cohorts are computed by blocks of chunk_size
+    const int nblocks = (ncohorts + chunk_size - 1)/chunk_size;
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1)
+#endif
+    for (int b = 0; b < nblocks; b++){
+        const int b0 = b*chunk_size;
+        const int m  = std::min(ncohorts, b0 + chunk_size) - b0;
+        const int *child = cohort_first.data() + b0;
+        std::vector<double> AGE(m), time(m), x(7*m);
+        double *curve = x.data() + 6*m;
+        for (int r = 0; r < m; r++){
+            AGE[r] = age[child[r]];
+        }
+        for (int stage = 0; stage < nstages; stage++){
+            const double offset = (stage == 0) ? 0.0 : ((stage % 2 == 1) ? 0.5 * dt/365.0 : dt/365.0);
+            for (int r = 0; r < m; r++){
+                time[r] = AGE[r] + offset;
+            }
+            ageTerms(m, child, time.data(), x.data());
+            if (generalized_logistic){
+                for (int r = 0; r < m; r++){
+                    curve[r] = -B_logistic*time[r];
+                }
+                vexp(curve, curve, m);
+                for (int r = 0; r < m; r++){
+                    curve[r] = logisticIntake(curve[r]);
+                }
+            }
+            for (int r = 0; r < m; r++){
+                double *y = table.data() + ((std::size_t) (b0 + r)*nstages + stage)*4;
+                y[0] = x[r];
+                y[1] = x[2*m + r];
+                y[2] = IntakeReference(time[r], x[m + r], x[r], x[2*m + r], constants[child[r]]);
+                y[3] = generalized_logistic ? curve[r] : 0.0;
+            }
+            
+            //The end of a step is the age of the next one
+            if (stage > 0 && stage % 2 == 0){
+                for (int r = 0; r < m; r++){
+                    AGE[r] = AGE[r] + dt/365.0;
+                }
+            }
+        }
+    }
+}
+
+//Terms of children first, ..., last - 1 at a stage of buildTables into c[j - first]
+template <class Source>
+void Child::tableTerms(int first, int last, int stage, int row, ChildTimeTerms *c){
+    for (int j = first; j < last; j++){
+        const double *y = table.data() + ((std::size_t) cohort[j]*nstages + stage)*4;
+        ChildTimeTerms &ck = c[j - first];
+        ck.intake = Source::value(*this, y + 3, 0, row, j);
+        ck.growth = y[0];
+        ck.delta  = y[1];
+        ck.Iref   = y[2];
+    }
+}
+
+template <typename T>
+T Child::Expenditure(const T &FFM, const T &FM, const ChildTimeTermsOf<T> &c,
+                     const ChildConstantsOf<T> &q){
+    T DeltaI    = c.intake - c.Iref;
+    T p         = cP(FFM, FM);
+    T rhoFFM    = cRhoFFM(FFM);
+    T Expend    = q.K + (22.4 + c.delta)*FFM + (4.5 + c.delta)*FM +
+                        0.24*DeltaI + (230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p))*c.intake +
+                        c.growth*(230.0/rhoFFM -180.0/rhoFM);
+    return Expend/(1.0+230.0/rhoFFM *p + 180.0/rhoFM*(1.0-p));
+}
+
+template <typename T>
+void Child::dMass(const T &FFM, const T &FM, const ChildTimeTermsOf<T> &c,
+                  const ChildConstantsOf<T> &q, T &dFFM, T &dFM){
+    T rhoFFM = cRhoFFM(FFM);
+    T p      = cP(FFM, FM);
+    T expend = Expenditure(FFM, FM, c, q);
+    dFFM          = (1.0*p*(c.intake - expend) + c.growth)/rhoFFM;    // dFFM
+    dFM           = ((1.0 - p)*(c.intake - expend) - c.growth)/rhoFM; //dFM
+}
+
+//Store the state of child j at step i
+void Child::record(int i, int j, double AGE, double FFM, double FM, std::vector<OutputStore> &store){
+    const std::size_t k = (std::size_t) i*nind + j;
+    store[OUT_AGE].put(k, AGE);
+    store[OUT_FFM].put(k, FFM);
+    store[OUT_FM].put(k, FM);
+    store[OUT_BW].put(k, FFM + FM);
+}
+
+//Output of rk4_fused: every step of every child to the stores of its variables
+//(nind x (nsims + 1) values in column-major order)
+struct Child::StoreOutput {
+    Child                    &model;
+    std::vector<OutputStore> &store;
+    int                       nsims;
+    int  steps(int j) const { return nsims; }
+    void record(int i, int j, double AGE, double FFM, double FM, const ChildTimeTerms &c){
+        model.record(i, j, AGE, FFM, FM, store);
+    }
+};
+
+//Fused Rungue Kutta 4 for children first, ..., last - 1. The state of the chunk
+//is kept in local buffers and every step is given to out, which integrates
+//child j up to step out.steps(j) (StoreOutput or ChildHandoff). rows contains the
+//three EIntake rows (t, t + dt/2, t + dt) of each step. Source is the intake of
+//the children (one of MatrixIntake, KnotsIntake or LogisticIntake) so each one
+//has its own loop. With check the state of the chunk is checked after every
+//step (see vflag) and the first invalid step of each child is kept in failed.
+template <class Source, class Output>
+void Child::integrateFused(int first, int last, int nsims, const int *rows, Output &out){
+    
+    double k1_ffm, k1_fm, k2_ffm, k2_fm, k3_ffm, k3_fm, k4_ffm, k4_fm;
+    
+    //State of the chunk
+    const int n = last - first;
+    std::vector<double> FFMk(n), FMk(n), AGEk(n);
+    for (int j = first; j < last; j++){
+        FFMk[j - first] = FFM[j];
+        FMk[j - first]  = FM[j];
+        AGEk[j - first] = age[j];
+    }
+    
+    //Children whose state is invalid (and those halted, see setSolver)
+    std::vector<unsigned char> bad(n, 0), stopped(n, 0);
+    if (check && (vflag(FFMk.data(), 0.0, bad.data(), n) | vflag(FMk.data(), 0.0, bad.data(), n))){
+        for (int k = 0; k < n; k++){
+            if (bad[k]){
+                failed[first + k] = step0;
+                stopped[k]        = halt;
+                bad[k]            = 0;
+            }
+        }
+    }
+    
+    //Terms of the ages at the start, middle and end of the step. k2 and k3 share
+    //the middle and the end of a step is the start of the next one (its age is
+    //t + dt/365.0).
+    std::vector<ChildTimeTerms> cur(n), half(n), full(n);
+    std::vector<double> work(8*n);
+    ChildGroups groups;
+    groupChildren(first, last, groups);
+    if (nsims > 0 && table.empty()){
+        timeTerms<Source>(first, last, AGEk.data(), 0.0, rows[0], groups, cur.data(), work.data());
+    } else if (nsims > 0){
+        tableTerms<Source>(first, last, 0, rows[0], cur.data());
+    }
+    
+    for (int i = 1; i <= nsims; i++){
+        
+        const int *row = rows + 3*(i-1);
+        
+        if (table.empty()){
+            timeTerms<Source>(first, last, AGEk.data(), 0.5 * dt/365.0, row[1], groups,
+                              half.data(), work.data());
+            timeTerms<Source>(first, last, AGEk.data(), dt/365.0, row[2], groups, full.data(),
+                              work.data());
+        } else {
+            tableTerms<Source>(first, last, 2*i - 1, row[1], half.data());
+            tableTerms<Source>(first, last, 2*i, row[2], full.data());
+        }
+        
+        for (int j = first; j < last; j++){
+            
+            if (i > out.steps(j)){
+                continue;
+            }
+            
+            const ChildConstants &q = constants[j];
+            const int    k   = j - first;
+            const double ffm = FFMk[k];
+            const double fm  = FMk[k];
+            
+            //Halted children only age
+            if (stopped[k]){
+                AGEk[k] = AGEk[k] + dt/365.0;
+                out.record(i, j, AGEk[k], NA_REAL, NA_REAL, full[k]);
+                continue;
+            }
+            
+            //Rungue kutta 4 (same scheme as rk4)
+            dMass(ffm, fm, cur[k], q, k1_ffm, k1_fm);
+            dMass(ffm + 0.5 * k1_ffm, fm + 0.5 * k1_fm, half[k], q, k2_ffm, k2_fm);
+            dMass(ffm + 0.5 * k2_ffm, fm + 0.5 * k2_fm, half[k], q, k3_ffm, k3_fm);
+            dMass(ffm + k3_ffm, fm + k3_fm, full[k], q, k4_ffm, k4_fm);
+            BW_PROFILE_RHS(4);
+            
+            FFMk[k] = ffm + dt*(k1_ffm + 2.0*k2_ffm + 2.0*k3_ffm + k4_ffm)/6.0;
+            FMk[k]  = fm  + dt*(k1_fm + 2.0*k2_fm + 2.0*k3_fm + k4_fm)/6.0;
+            AGEk[k] = AGEk[k] + dt/365.0;
+            out.record(i, j, AGEk[k], FFMk[k], FMk[k], full[k]);
+        }
+        cur.swap(full);
+        
+        //First invalid state of each child
+        if (check && (vflag(FFMk.data(), 0.0, bad.data(), n) | vflag(FMk.data(), 0.0, bad.data(), n))){
+            for (int k = 0; k < n; k++){
+                if (bad[k]){
+                    if (failed[first + k] < 0){
+                        failed[first + k] = step0 + i;
+                    }
+                    stopped[k] = halt;
+                    bad[k]     = 0;
+                }
+            }
+        }
+        
+        //State at the checkpoints
+        if (!checkpoint_at.empty() && checkpoint_at[i] >= 0){
+            const std::size_t c = 3*checkpoint_at[i];
+            std::copy(AGEk.begin(), AGEk.end(), saved.begin() + c*nind + first);
+            std::copy(FFMk.begin(), FFMk.end(), saved.begin() + (c + 1)*nind + first);
+            std::copy(FMk.begin(), FMk.end(), saved.begin() + (c + 2)*nind + first);
+        }
+    }
+}
+
+//Fused engine of a lifecourse run (see Lifecourse) with the intake of the children
+void Child::integrateHandoff(int first, int last, int nsims, const int *rows, ChildHandoff &out){
+    if (generalized_logistic){
+        integrateFused<LogisticIntake>(first, last, nsims, rows, out);
+    } else if (EIknots.active){
+        integrateFused<KnotsIntake>(first, last, nsims, rows, out);
+    } else {
+        integrateFused<MatrixIntake>(first, last, nsims, rows, out);
+    }
+}
+
+//ODEs of child j with the intake of one row of EIntake. t is the time in days
+//since the start of the simulation.
+struct Child::System {
+    Child  *model;
+    int     j;
+    int     row;
+    double  age;
+    void operator()(double t, const double *y, double *dy){
+        ChildTimeTerms c;
+        model->timeTerms(age + t/365.0, row, j, c);
+        model->dMass(y[0], y[1], c, model->constants[j], dy[0], dy[1]);
+        BW_PROFILE_RHS(1);
+    }
+};
+
+//Adaptive Dormand Prince method for children first, ..., last - 1 (same layout as
+//integrateFused). Each child is integrated from one change of its intake to the
+//next and the states at TIME are obtained from the dense output. A halted child
+//is integrated up to the next change of its intake after its first invalid
+//state and stores NA from that state on.
+void Child::integrateAdaptive(int first, int last, int nsims, const double *TIME,
+                              std::vector<OutputStore> &store){
+    
+    for (int j = first; j < last; j++){
+        
+        //State (FFM, FM) and age at the last grid point
+        double y[2] = {FFM[j], FM[j]};
+        double agej = age[j];
+        
+        System f;
+        f.model = this;
+        f.j     = j;
+        f.age   = age[j];
+        DormandPrince<2> solver(tolerance);
+        
+        //Stores the grid points of every accepted step
+        int  i       = 1;
+        bool invalid = check && !validMass(y[0], y[1]);
+        bool stopped = halt && invalid;
+        if (invalid){
+            failed[j] = step0;
+        }
+        auto emit = [&](const DormandPrince<2> &step, const double *ynew) -> bool {
+            for (; i <= nsims && TIME[i] <= step.t_new; i++){
+                double yi[2];
+                if (TIME[i] == step.t_new){
+                    std::copy(ynew, ynew + 2, yi);
+                } else {
+                    step.dense(TIME[i], yi);
+                }
+                agej = agej + dt/365.0;
+                if (stopped){
+                    yi[0] = yi[1] = NA_REAL;
+                } else if (check && !validMass(yi[0], yi[1])){
+                    if (failed[j] < 0){
+                        failed[j] = step0 + i;
+                    }
+                    stopped = halt;
+                }
+                record(i, j, agej, yi[0], yi[1], store);
+            }
+            return !stopped;
+        };
+        
+        //Steps row0, ..., row1 - 1 have the same intake (the logistic curve is smooth)
+        int row0 = 0;
+        while (row0 < nsims && !stopped){
+            int row1 = row0 + 1;
+            if (generalized_logistic){
+                row1 = nsims;
+            } else {
+                while (row1 < nsims && Intake(0.0, row1, j) == Intake(0.0, row0, j)){
+                    row1++;
+                }
+            }
+            f.row = row0;
+            double h = dt;
+            solver.integrate(f, TIME[row0], y, TIME[row1], h, emit);
+            row0 = row1;
+        }
+        
+        //Grid points after a halt
+        for (; i <= nsims; i++){
+            agej = agej + dt/365.0;
+            record(i, j, agej, NA_REAL, NA_REAL, store);
+        }
     }
+}
+
+//Derivatives of the body weight of every child with respect to the constants of
+//setStorage's sensitivity (K or deltamax) at each of the nsims steps of rows (as
+//in integrateFused). Every child is integrated again by RK4 (whatever the method
+//of setSolver) with dual numbers carrying the derivatives.
+List Child::sensitivity(int nsims, const int *rows, const double *TIME, int threads){
+    
+    std::vector<int> which;
+    std::vector<OutputStore> store;
+    for (std::size_t k = 0; k < sensitivities.size(); k++){
+        which.push_back(std::find(child_parameters, child_parameters + nchild_parameters,
+                                  sensitivities[k]) - child_parameters);
+        store.push_back(OutputStore((std::size_t) nind*(nsims + 1), "double", 1.0, ""));
+    }
+    
+    const int nchunks = (nind + chunk_size - 1)/chunk_size;
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1)
+#endif
+    for (int c = 0; c < nchunks; c++){
+        integrateSensitivity(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims, rows,
+                             which, store);
+    }
+    
+    IntegerVector dims = IntegerVector::create(nind, nsims + 1);
+    List results = List::create(Named("Time") = NumericVector(TIME, TIME + nsims + 1));
+    for (std::size_t k = 0; k < sensitivities.size(); k++){
+        results.push_back(store[k].wrap(dims), sensitivities[k]);
+    }
+    return results;
+}
+
+//Sensitivities of children first, ..., last - 1 with duals of as few derivatives
+//as the constants in which
+void Child::integrateSensitivity(int first, int last, int nsims, const int *rows,
+                                 const std::vector<int> &which, std::vector<OutputStore> &store){
+    if (which.size() == 1){
+        integrateSensitivity<1>(first, last, nsims, rows, which, store);
+    } else {
+        integrateSensitivity<nchild_parameters>(first, last, nsims, rows, which, store);
+    }
+}
+
+//Same with duals of N derivatives (derivative k is that of constant which[k]).
+//Each child follows the RK4 scheme of integrateFused with the terms of its age
+//evaluated one child at a time.
+template <int N>
+void Child::integrateSensitivity(int first, int last, int nsims, const int *rows,
+                                 const std::vector<int> &which, std::vector<OutputStore> &store){
+    
+    typedef Dual<N> D;
+    D k1_ffm, k1_fm, k2_ffm, k2_fm, k3_ffm, k3_fm, k4_ffm, k4_fm;
+    ChildTimeTermsOf<D> cur, half, full;
+    
+    for (int j = first; j < last; j++){
+        
+        //Constants of the child seeded with their derivatives
+        const ChildConstants &c = constants[j];
+        D seed[nchild_parameters] = {D(c.K), D(c.deltamax)};
+        for (std::size_t k = 0; k < which.size(); k++){
+            seed[which[k]] = D::variable(value(seed[which[k]]), k);
+        }
+        ChildConstantsOf<D> q;
+        q.K        = seed[SENS_K];
+        q.deltamax = seed[SENS_DELTAMAX];
+        q.growth   = c.growth;
+        q.eb       = c.eb;
+        q.ffm_ref  = c.ffm_ref;
+        q.fm_ref   = c.fm_ref;
+        
+        D ffm = FFM[j];
+        D fm  = FM[j];
+        double agej = age[j];
+        for (std::size_t k = 0; k < which.size(); k++){
+            store[k].put(j, 0.0);
+        }
+        if (nsims > 0){
+            timeTerms(agej, rows[0], j, q, cur);
+        }
+        
+        for (int i = 1; i <= nsims; i++){
+            
+            const int *row = rows + 3*(i-1);
+            timeTerms(agej + 0.5 * dt/365.0, row[1], j, q, half);
+            timeTerms(agej + dt/365.0, row[2], j, q, full);
+            
+            dMass(ffm, fm, cur, q, k1_ffm, k1_fm);
+            dMass(ffm + 0.5 * k1_ffm, fm + 0.5 * k1_fm, half, q, k2_ffm, k2_fm);
+            dMass(ffm + 0.5 * k2_ffm, fm + 0.5 * k2_fm, half, q, k3_ffm, k3_fm);
+            dMass(ffm + k3_ffm, fm + k3_fm, full, q, k4_ffm, k4_fm);
+            
+            ffm  = ffm + dt*(k1_ffm + 2.0*k2_ffm + 2.0*k3_ffm + k4_ffm)/6.0;
+            fm   = fm  + dt*(k1_fm + 2.0*k2_fm + 2.0*k3_fm + k4_fm)/6.0;
+            agej = agej + dt/365.0;
+            cur  = full;
+            
+            const D bw = ffm + fm;
+            for (std::size_t k = 0; k < which.size(); k++){
+                store[k].put((std::size_t) i*nind + j, bw.d[k]);
+            }
+        }
+    }
+}
+
+//Rungue Kutta 4 method for Child evaluating each individual in a single loop over
+//plain doubles. Individuals are split in chunks of chunk_size that are integrated
+//by up to threads workers; results do not depend on the number of threads.
+//Outputs are stored with the precision (and in the files) of setStorage.
+//Rows of EIntake at the three stages (t, t + dt/2, t + dt) of each of nsteps steps
+//from baseline. As in Intake they are computed from the age of the first individual.
+void Child::intakeRows(int nsteps, std::vector<int> &rows){
+    rows.resize(3*nsteps);
+    const double age_start = (nind > 0) ? age_base(0) : 0.0;
+    double age_first = age_start;
+    for (int i = 1; i <= nsteps; i++){
+        rows[3*(i-1)]     = floor(365.0*(age_first - age_start)/dt);
+        rows[3*(i-1) + 1] = floor(365.0*((age_first + 0.5 * dt/365.0) - age_start)/dt);
+        rows[3*(i-1) + 2] = floor(365.0*((age_first + dt/365.0) - age_start)/dt);
+        age_first         = age_first + dt/365.0;
+    }
+}
+
+List Child::rk4_fused (double days, int threads){
+    
+    BW_PROFILE_PHASE("setup");
+    
+    //Estimate number of elements to loop into (after the checkpoint when resuming)
+    const int nsteps = floor(days/dt);
+    const int nsims  = nsteps - step0;
+    if (nsims < 0){
+        stop("Invalid days. A resumed run must end after its checkpoint.");
+    }
+    
+    //Steps whose state is saved
+    if ((checkpoint_steps.size() > 0 || step0 > 0) && adaptive){
+        stop("Invalid checkpoint. Checkpoints require method = 'RK4'.");
+    }
+    checkpoint_at.assign(checkpoint_steps.empty() ? 0 : nsims + 1, -1);
+    for (std::size_t c = 0; c < checkpoint_steps.size(); c++){
+        const int i = checkpoint_steps[c] - step0;
+        if (i < 1 || i > nsims){
+            stop("Invalid checkpoint. Checkpoints must be taken after the start and before the end of the run.");
+        }
+        checkpoint_at[i] = c;
+    }
+    saved.assign((std::size_t) 3*checkpoint_steps.size()*nind, NA_REAL);
+    if (sensitivities.size() > 0 && step0 > 0){
+        stop("Invalid sensitivity. Sensitivities are integrated from baseline (not from a checkpoint).");
+    }
+    
+    //Storage of the outputs (nind x (nsims + 1) values each)
+    std::vector<std::string> names(child_variables, child_variables + nchild_variables);
+    std::vector<double>      unit = getResolution(resolution, names);
+    std::vector<OutputStore> store;
+    for (int v = 0; v < nchild_variables; v++){
+        store.push_back(OutputStore((std::size_t) nind*(nsims + 1), precision, unit[v],
+                                    path.empty() ? "" : path + "/" + names[v] + ".bin"));
+    }
+    NumericVector TIME(nsteps + 1); //in rcpp
+    
+    //Create initial states (those of the checkpoint when resuming)
+    for (int j = 0; j < nind; j++){
+        record(0, j, age[j], FFM[j], FM[j], store);
+    }
+    TIME(0)  = 0.0;
+    
+    //Rows of EIntake at each stage (and times) from baseline
+    std::vector<int> rows;
+    intakeRows(nsteps, rows);
+    for (int i = 1; i <= nsteps; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    
+    //Workers only see plain pointers (no R API is called outside the main thread)
+    const int *rows_ptr = rows.data() + 3*step0;
+    const double *time_ptr = TIME.begin() + step0;
+    failed.assign(nind, -1);
+    
+    //Terms shared by the cohorts
+    BW_PROFILE_PHASE("tables");
+    buildTables(nsims, threads);
+    
+    //Integrate every individual by chunks
+    BW_PROFILE_PHASE("integrate");
+    const int nchunks = (nind + chunk_size - 1)/chunk_size;
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1)
+#endif
+    for (int c = 0; c < nchunks; c++){
+        BW_PROFILE_CHUNK();
+        StoreOutput out = {*this, store, nsims};
+        if (adaptive){
+            integrateAdaptive(c*chunk_size, std::min(nind, (c + 1)*chunk_size), nsims, time_ptr,
+                              store);
+        } else if (generalized_logistic){
+            integrateFused<LogisticIntake>(c*chunk_size, std::min(nind, (c + 1)*chunk_size),
+                                           nsims, rows_ptr, out);
+        } else if (EIknots.active){
+            integrateFused<KnotsIntake>(c*chunk_size, std::min(nind, (c + 1)*chunk_size),
+                                        nsims, rows_ptr, out);
+        } else {
+            integrateFused<MatrixIntake>(c*chunk_size, std::min(nind, (c + 1)*chunk_size),
+                                         nsims, rows_ptr, out);
+        }
+    }
+    std::vector<double>().swap(table);
+    
+    //Same as rk4 with whether the state of each child was valid at every step
+    //and the time of its first invalid step
+    BW_PROFILE_PHASE("wrap");
+    IntegerVector dims = IntegerVector::create(nind, nsims + 1);
+    LogicalVector correctVals(nind); //in rcpp
+    NumericVector failedTime(nind);  //in rcpp
+    for (int j = 0; j < nind; j++){
+        correctVals[j] = failed[j] < 0;
+        failedTime[j]  = failed[j] < 0 ? NA_REAL : TIME[failed[j]];
+    }
+    
+    List results = List::create(Named("Time") = NumericVector(TIME.begin() + step0, TIME.end()),
+                                Named("Age") = store[OUT_AGE].wrap(dims),
+                                Named("Fat_Free_Mass") = store[OUT_FFM].wrap(dims),
+                                Named("Fat_Mass") = store[OUT_FM].wrap(dims),
+                                Named("Body_Weight") = store[OUT_BW].wrap(dims),
+                                Named("Correct_Values")=correctVals,
+                                Named("Failed_Time")=failedTime,
+                                Named("Model_Type")="Children");
+    
+    //Derivatives of the body weight
+    if (sensitivities.size() > 0){
+        BW_PROFILE_PHASE("sensitivity");
+        results.push_back(sensitivity(nsims, rows_ptr, time_ptr, threads), "Sensitivity");
+        BW_PROFILE_PHASE("wrap");
+    }
+    
+    //Saved states
+    if (checkpoint_steps.size() > 0){
+        List checkpoints;
+        for (std::size_t c = 0; c < checkpoint_steps.size(); c++){
+            checkpoints.push_back(checkpoint(c, TIME[checkpoint_steps[c]]));
+        }
+        results.push_back(checkpoints, "Checkpoint");
+    }
+    
+    return results;
     
 }
@@ -31,9 +31,60 @@
 #define child_weight_h
 
 #include <math.h>
+#include <vector>
 #include <Rcpp.h>
+#include "energy_knots.h"
+#include "input_view.h"
+#include "dormand_prince.h"
+#include "output_store.h"
 using namespace Rcpp;
 
+//Children of a lifecourse run that become adults (see lifecourse.h)
+struct ChildHandoff;
+class Lifecourse;
+
+//Parameters of one of the general_ode terms (growth or energy balance)
+struct ChildTerms {
+    double A, B, D;
+    double tA, tB, tD;
+    double tauA, tauB, tauD;
+};
+
+//Plain (R-free) constants of a child used by the fused engine. K and deltamax
+//may be dual numbers carrying their derivatives (see sensitivity).
+template <typename T>
+struct ChildConstantsOf {
+    T          K;
+    T          deltamax;
+    ChildTerms growth;        //Growth_dynamic
+    ChildTerms eb;            //EB_impact
+    const double *ffm_ref;    //Reference FFM from 2 to 18 years (row of ffm_reference)
+    const double *fm_ref;     //Reference FM from 2 to 18 years (row of fm_reference)
+};
+typedef ChildConstantsOf<double> ChildConstants;
+
+//Terms of the ODEs of a child that only depend on its age (shared by the RK
+//stages of a step at the same time)
+template <typename T>
+struct ChildTimeTermsOf {
+    double intake;   //Intake
+    double growth;   //Growth_dynamic
+    T      Iref;     //IntakeReference
+    T      delta;    //Delta
+};
+typedef ChildTimeTermsOf<double> ChildTimeTerms;
+
+//Children of a chunk of the fused engine with the same age and sex (which share
+//the terms of general_ode and Delta) and with the same age (which share the
+//Richards curve). Their ages stay equal as all of them advance by dt.
+struct ChildGroups {
+    std::vector<int> terms;        //Group of the same age and sex of each child
+    std::vector<int> terms_first;  //First child of each of those groups
+    std::vector<int> terms_child;  //Same as terms_first counted from the first child
+    std::vector<int> ages;         //Group of the same age of each child
+    std::vector<int> ages_first;   //First child of each of those groups
+};
+
 //Create a Adult class to contain individual parameters
 //--------------------------------------------------------------------------------
 class Child {
@@ -52,13 +103,19 @@ public:
     NumericVector bmiCat;  // From 1 to 4: Underweight, normal, overweight and obese
     NumericVector FFM;  //Fat Free Mass (kg)
     NumericVector FM;   //Fat Mass (kg)
-    NumericMatrix EIntake;
+    NumericMatrix EIntake; //Days x nind (or a single row and (or) column shared by them)
+    EnergyKnots   EIknots; //Knots of the energy intake evaluated on demand instead of EIntake
     bool          check; // Check values are correct
     double referenceValues; //
     
     //Functions
     //---------------------------------------------------------------------------
     List rk4(double days);
+    List rk4_fused(double days, int threads = 1); //Same as rk4 but allocation-free over plain doubles
+    void setKnots(List knots); //Use knots for EIntake
+    void setSolver(List solver); //Integration method of rk4_fused ("RK4" or "RK45")
+    void setStorage(List storage); //Precision of the values returned by rk4_fused
+    void setCheckpoints(List checkpoints); //Save (or resume from) the state of rk4_fused
     
     //Reference functions for reference children
     NumericVector IntakeReference(NumericVector t);
@@ -67,6 +124,9 @@ public:
     
 private:
     
+    //Lifecourse runs the fused engine up to the age at which children become adults
+    friend class Lifecourse;
+    
     //Private unchanging constants
     double rhoFM; //kcals/g -> kcals/kg
     double deltamin;
@@ -74,10 +134,40 @@ private:
     double h;
     double dt;
     bool generalized_logistic;
+    bool   adaptive;  //Use the adaptive Dormand Prince method instead of RK4
+    double tolerance; //Relative and absolute tolerance of the adaptive method
+    bool   tables;    //Precompute the terms of each cohort of the fused engine (see buildTables)
+    bool   halt;      //Stop integrating the children whose state is invalid (see setSolver)
+    std::string precision;  //Storage of the outputs of rk4_fused (see OutputStore)
+    List        resolution; //Resolution of each output for the fixed point precisions
+    std::string path;       //Directory where the outputs are written (empty for memory)
+    std::vector<std::string> sensitivities; //Constants whose sensitivities are returned
+    
+    //System of ODEs of a child for the adaptive method
+    struct System;
+    
+    //Intake sources of the fused engine (see integrateFused)
+    struct MatrixIntake;
+    struct KnotsIntake;
+    struct LogisticIntake;
+    
+    //Outputs of the fused engine (see integrateFused)
+    struct StoreOutput;
     
     //Number of individuals
     int nind;
     
+    //Checkpoints of rk4_fused (see setCheckpoints)
+    NumericVector       age_base;         //Age at the start of the simulation (gives the rows of EIntake)
+    std::vector<int>    checkpoint_steps; //Time steps whose state is saved
+    std::vector<int>    checkpoint_at;    //Checkpoint of each step integrated (-1 if none)
+    std::vector<double> saved;            //Age, FFM and FM of every child at each checkpoint
+    int                 step0;            //Time step at which the integration starts
+    
+    //First time step (from baseline) at which FFM or FM of each child of
+    //rk4_fused is not positive and finite, -1 if it never is
+    std::vector<int>    failed;
+    
     //Constants additional
     NumericVector K;
     NumericVector deltamax;
@@ -129,9 +219,20 @@ private:
     NumericVector fm_beta0;
     NumericVector fm_beta1;
     
+    //Per individual constants for the fused engine (see getConstants)
+    std::vector<ChildConstants> constants;
+    InputView                   EIview;  //EIntake read as days x nind (see input_view.h)
+    
+    //Terms of each cohort at each stage of the fused engine (see buildTables)
+    std::vector<double> table;   //Growth_dynamic, Delta, IntakeReference and Richards curve
+    std::vector<int>    cohort;  //Cohort of each child
+    int                 nstages; //Stages (start, middle and end of each step) of the table
+    
     //Function s involved
     void build(void);
     void getParameters();
+    void getSexConstants(void);
+    void getConstants(void);
     NumericVector Growth_dynamic(NumericVector t); //Growth function from Dynamics...
     NumericVector Growth_impact(NumericVector t);   //Growth function from Impact...
     NumericVector EB_impact(NumericVector t);   //Energy Balance function from Impact...
@@ -146,6 +247,57 @@ private:
     NumericVector Expenditure(NumericVector t, NumericVector FFM, NumericVector FM);
     NumericVector Intake(NumericVector t);
     NumericMatrix dMass (NumericVector time, NumericVector FFM, NumericVector FM);
+    
+    //Scalar versions for a single individual used by the fused engine (T is
+    //double or a dual number, see sensitivity)
+    double general_ode(double t, const ChildTerms &q);
+    template <typename T>
+    T      cRhoFFM(const T &input_FFM);
+    template <typename T>
+    T      cP(const T &FFM, const T &FM);
+    template <typename T>
+    T      Delta(double t, const ChildConstantsOf<T> &q);
+    template <typename T>
+    double FFMReference(double t, const ChildConstantsOf<T> &q);
+    template <typename T>
+    double FMReference(double t, const ChildConstantsOf<T> &q);
+    template <typename T>
+    T      IntakeReference(double t, double EB, double growth, const T &delta,
+                           const ChildConstantsOf<T> &q);
+    double Intake(double t, int row, int j);
+    double logisticIntake(double expBt);
+    template <typename T>
+    void   timeTerms(double t, int row, int j, const ChildConstantsOf<T> &q,
+                     ChildTimeTermsOf<T> &c);
+    void   timeTerms(double t, int row, int j, ChildTimeTerms &c);
+    void   groupChildren(int first, int last, ChildGroups &g);
+    void   ageTerms(int m, const int *child, const double *time, double *x);
+    void   buildTables(int nsims, int threads);
+    template <class Source>
+    void   tableTerms(int first, int last, int stage, int row, ChildTimeTerms *c);
+    template <class Source>
+    void   timeTerms(int first, int last, const double *t, double offset, int row,
+                     const ChildGroups &g, ChildTimeTerms *c, double *work);
+    template <typename T>
+    T      Expenditure(const T &FFM, const T &FM, const ChildTimeTermsOf<T> &c,
+                       const ChildConstantsOf<T> &q);
+    template <typename T>
+    void   dMass(const T &FFM, const T &FM, const ChildTimeTermsOf<T> &c,
+                 const ChildConstantsOf<T> &q, T &dFFM, T &dFM);
+    void   record(int i, int j, double AGE, double FFM, double FM, std::vector<OutputStore> &store);
+    void   intakeRows(int nsteps, std::vector<int> &rows);
+    template <class Source, class Output>
+    void   integrateFused(int first, int last, int nsims, const int *rows, Output &out);
+    void   integrateHandoff(int first, int last, int nsims, const int *rows, ChildHandoff &out);
+    void   integrateAdaptive(int first, int last, int nsims, const double *TIME,
+                             std::vector<OutputStore> &store);
+    List   checkpoint(int c, double time);
+    List   sensitivity(int nsims, const int *rows, const double *TIME, int threads);
+    void   integrateSensitivity(int first, int last, int nsims, const int *rows,
+                                const std::vector<int> &which, std::vector<OutputStore> &store);
+    template <int N>
+    void   integrateSensitivity(int first, int last, int nsims, const int *rows,
+                                const std::vector<int> &which, std::vector<OutputStore> &store);
 };
 
 
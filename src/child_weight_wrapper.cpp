@@ -10,7 +10,8 @@
 //  sex             .-  Either 1 = "female" or 0 = "male"
 //  FFM             .-  Fat Free Mass (kg) of the individual
 //  FM              .-  Fat Mass (kg) of the individual
-//  input_EIntake   .-  Energy intake (kcal) of individual per day
+//  input_EIntake   .-  Energy intake (kcal) of individual per day (days x nind, or a
+//                      single row and (or) column read without expanding it)
 //  days            .-  Days to model (integer)
 //  dt              .-  Time step used to solve the ODE system numerically
 //  K               .-  Richardson parameter
@@ -19,6 +20,13 @@
 //  B               .-  Richardson parameter
 //  nu              .-  Richardson parameter
 //  C               .-  Richardson parameter
+//  threads         .-  Number of threads used to integrate the individuals
+//  knots           .-  List with the knots (energy, time and interpolation) of the energy
+//                      intake used instead of input_EIntake (see Child::setKnots)
+//  solver          .-  List with the integration method ("RK4" or "RK45") and the
+//                      tolerance of the adaptive method (see Child::setSolver)
+//  storage         .-  List with the precision and the resolution of the values of
+//                      the outputs (see Child::setStorage)
 //  Note:
 //  Weight = FFM + FM. No extracellular fluid or glycogen is considered
 //  Please see child_weight.hpp for additional information
@@ -74,26 +82,44 @@
 
 #include <Rcpp.h>
 #include "child_weight.h"
+#include "profile.h"
 
 // [[Rcpp::export]]
-List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, double referenceValues){
+List child_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake, double days, double dt, bool checkValues, double referenceValues, int threads, List knots, List solver, List storage, List checkpoints){
+    
+    BW_PROFILE_START(threads, "build");
     
     //Create new adult with characteristics
     Child Person (age,  sex, bmiCat, FFM, FM, input_EIntake, dt, checkValues, referenceValues);
     
-    //Run model using RK4
-    return Person.rk4(days - 1); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    //Energy intake given by its knots
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    Person.setStorage(storage);
+    Person.setCheckpoints(checkpoints);
+    
+    //Run model using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days - 1, threads); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    BW_PROFILE_ATTACH(results);
+    return results;
     
 }
 
 // [[Rcpp::export]]
-List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, double referenceValues){
+List child_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat, NumericVector FFM, NumericVector FM, double K, double Q, double A, double B, double nu, double C, double days, double dt, bool checkValues, double referenceValues, int threads, List solver, List storage, List checkpoints){
+    
+    BW_PROFILE_START(threads, "build");
     
     //Create new adult with characteristics
     Child Person (age,  sex, bmiCat, FFM, FM, K, Q, A, B, nu, C, dt, checkValues, referenceValues);
-    
-    //Run model using RK4
-    return Person.rk4(days - 1); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    Person.setSolver(solver);
+    Person.setStorage(storage);
+    Person.setCheckpoints(checkpoints);
+    
+    //Run model using the fused RK4 (or the adaptive method)
+    List results = Person.rk4_fused(days - 1, threads); //days - 1 to account for extra day (c++ indexing starts in 0; R in 1)
+    BW_PROFILE_ATTACH(results);
+    return results;
     
 }
 
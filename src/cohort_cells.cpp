@@ -0,0 +1,141 @@
+//
+//  cohort_cells.cpp
+//
+//  This is a class that finds the cells of identical individuals of a model
+//  (same parameters and input trajectories) so that each cell is integrated
+//  only once. Individuals are hashed over all their inputs and individuals
+//  with the same hash are compared value by value, so two individuals share a
+//  cell only if every input is exactly the same.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "cohort_cells.h"
+#include <cstring>
+#include <unordered_map>
+
+//Value of an input as the bits that are hashed (-0 and 0 are the same value)
+static inline std::uint64_t cellBits(double x){
+    std::uint64_t bits;
+    x = x + 0.0;
+    std::memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+//Mix a value into a hash (FNV-1a over 64 bit words with the finaliser of
+//splitmix64 so that close values give far hashes)
+static inline std::uint64_t cellMix(std::uint64_t h, std::uint64_t bits){
+    h = (h ^ bits)*0x100000001B3ULL;
+    h = (h ^ (h >> 30))*0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27))*0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+CohortCells::CohortCells(int input_nind){
+    nind = input_nind;
+    hash.assign(nind, 0xCBF29CE484222325ULL);
+}
+
+void CohortCells::addRows(NumericVector x){
+    if (nind == 0 || x.size() % nind != 0){
+        stop("Dimension mismatch. Inputs must have one row per individual.");
+    }
+    add(x, x.size()/nind, nind, 1);
+}
+
+void CohortCells::addColumns(NumericVector x){
+    if (nind == 0 || x.size() % nind != 0){
+        stop("Dimension mismatch. Inputs must have one column per individual.");
+    }
+    add(x, x.size()/nind, 1, x.size()/nind);
+}
+
+void CohortCells::add(NumericVector x, int length, std::size_t stride, std::size_t offset){
+    values.push_back(x);
+    Input input = {values.back().begin(), length, stride, offset};
+    inputs.push_back(input);
+    
+    //Values are visited in memory order (individuals of one column of a
+    //matrix with a row per individual are contiguous)
+    if (stride == 1){
+        for (int j = 0; j < nind; j++){
+            const double *y = input.x + j*offset;
+            for (int i = 0; i < length; i++){
+                hash[j] = cellMix(hash[j], cellBits(y[i]));
+            }
+        }
+    } else {
+        for (int i = 0; i < length; i++){
+            const double *y = input.x + i*stride;
+            for (int j = 0; j < nind; j++){
+                hash[j] = cellMix(hash[j], cellBits(y[j]));
+            }
+        }
+    }
+}
+
+//Whether individuals a and b have exactly the same inputs
+bool CohortCells::equal(int a, int b) const {
+    for (unsigned int k = 0; k < inputs.size(); k++){
+        const Input  &input = inputs[k];
+        const double *x     = input.x + a*input.offset;
+        const double *y     = input.x + b*input.offset;
+        for (int i = 0; i < input.length; i++){
+            if (cellBits(x[i*input.stride]) != cellBits(y[i*input.stride])){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+//Individuals are assigned to cells in order so the first individual of each cell
+//is the first one with its inputs. Cells with the same hash (collisions) are kept
+//in a list and told apart by equal.
+void CohortCells::cells(std::vector<int> &cell, std::vector<int> &first) const {
+    std::unordered_map<std::uint64_t, int> head;  //First cell with each hash
+    std::vector<int>                       next;  //Next cell with the same hash
+    head.reserve(nind);
+    cell.resize(nind);
+    first.clear();
+    for (int j = 0; j < nind; j++){
+        std::unordered_map<std::uint64_t, int>::iterator it = head.find(hash[j]);
+        int c    = it == head.end() ? -1 : it->second;
+        int last = -1;
+        while (c >= 0 && !equal(first[c], j)){
+            last = c;
+            c    = next[c];
+        }
+        if (c < 0){
+            c = first.size();
+            first.push_back(j);
+            next.push_back(-1);
+            if (last < 0){
+                head[hash[j]] = c;
+            } else {
+                next[last] = c;
+            }
+        }
+        cell[j] = c;
+    }
+}
@@ -0,0 +1,76 @@
+//
+//  cohort_cells.h
+//
+//  This is a class that finds the cells of identical individuals of a model
+//  (same parameters and input trajectories) so that each cell is integrated
+//  only once. Individuals are hashed over all their inputs and individuals
+//  with the same hash are compared value by value, so two individuals share a
+//  cell only if every input is exactly the same.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef cohort_cells_h
+#define cohort_cells_h
+
+#include <vector>
+#include <cstdint>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class CohortCells {
+public:
+    
+    //Cells of nind individuals (with no inputs every individual is in the same cell)
+    CohortCells(int nind);
+    
+    //Inputs of the individuals: x has nind rows (individual j is x[i*nind + j] for
+    //each column i; a vector is a matrix of one column) or nind columns (individual
+    //j is x[j*nrow + i] for each row i)
+    void addRows(NumericVector x);
+    void addColumns(NumericVector x);
+    
+    //Cell (0-based) of each individual and first individual of each cell
+    void cells(std::vector<int> &cell, std::vector<int> &first) const;
+    
+private:
+    
+    //Layout of an input
+    struct Input {
+        const double *x;
+        int           length;   //Values of each individual
+        std::size_t   stride;   //Distance between two values of an individual
+        std::size_t   offset;   //Distance between two individuals
+    };
+    
+    int                        nind;
+    std::vector<NumericVector> values;  //Inputs (kept so x stays valid)
+    std::vector<Input>         inputs;
+    std::vector<std::uint64_t> hash;    //Hash of the inputs of each individual
+    
+    void add(NumericVector x, int length, std::size_t stride, std::size_t offset);
+    bool equal(int a, int b) const;
+};
+
+#endif /* cohort_cells_h */
@@ -0,0 +1,71 @@
+//
+//  cohort_cells_wrapper.cpp
+//
+//  This is a function that uses Rcpp to return the cells of identical
+//  individuals of a model (see cohort_cells.h).
+//
+//  Input:
+//  nind            .-  Number of individuals.
+//  rows            .-  List of vectors (one value per individual) and matrices with
+//                      one row per individual (as EIchange of adult_weight).
+//  columns         .-  List of matrices with one column per individual (as EI of
+//                      child_weight).
+//
+//  Output:
+//  cell            .-  Cell (1, ..., ncells) of each individual.
+//  first           .-  First individual of each cell (the one integrated).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include <Rcpp.h>
+#include "cohort_cells.h"
+
+// [[Rcpp::export]]
+List cohort_cells_wrapper(int nind, List rows, List columns){
+    
+    //Hash every input of the individuals
+    CohortCells cohort(nind);
+    for (int k = 0; k < rows.size(); k++){
+        cohort.addRows(as<NumericVector>(rows[k]));
+    }
+    for (int k = 0; k < columns.size(); k++){
+        cohort.addColumns(as<NumericVector>(columns[k]));
+    }
+    
+    //Cells and their first individual (starting in 1 for R)
+    std::vector<int> cell, first;
+    cohort.cells(cell, first);
+    IntegerVector cellid(nind);
+    IntegerVector firstid(first.size());
+    for (int j = 0; j < nind; j++){
+        cellid[j] = cell[j] + 1;
+    }
+    for (unsigned int c = 0; c < first.size(); c++){
+        firstid[c] = first[c] + 1;
+    }
+    
+    return List::create(Named("cell")  = cellid,
+                        Named("first") = firstid);
+    
+}
@@ -0,0 +1,184 @@
+//
+//  dormand_prince.h
+//
+//  Adaptive step Runge Kutta method of Dormand and Prince (order 5 with an
+//  embedded order 4 error estimate) with the dense output of order 4 of
+//  Hairer, Norsett and Wanner. It is used by the adult and children models
+//  when method = "RK45" to take large steps while the trajectories are smooth
+//  and report the states on the time grid through the dense output.
+//
+//  The system is a functor with
+//      void operator()(double t, const double *y, double *dy)
+//  and N equations.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+// References:
+//
+//  Dormand, J R, and P J Prince. 1980. “A Family of Embedded Runge-Kutta Formulae.”
+//      Journal of Computational and Applied Mathematics 6 (1): 19–26.
+//
+//  Hairer, Ernst, Syvert P Norsett, and Gerhard Wanner. 1993. Solving Ordinary Differential
+//      Equations I: Nonstiff Problems. Springer Series in Computational Mathematics 8.
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef dormand_prince_h
+#define dormand_prince_h
+
+#include <math.h>
+#include <algorithm>
+
+template <int N>
+class DormandPrince {
+public:
+    
+    //tolerance: relative and absolute tolerance of each step
+    DormandPrince(double input_tolerance) : tolerance(input_tolerance), steps(0) {}
+    
+    double tolerance;
+    int    steps;        //Accepted steps
+    
+    //Start and end of the last accepted step
+    double t_old, t_new;
+    
+    //Integrate the system f from y at time t to tend with a first step h. Each
+    //accepted step calls emit(*this, y_new) so that the caller can get
+    //the states at times in (t_old, t_new] with dense; emit returns false to
+    //stop at t_new. On return y holds the state at tend (or t_new) and h the
+    //step to use next.
+    template <class F, class E>
+    void integrate(F &f, double t, double *y, double tend, double &h, E &emit){
+        
+        double k1[N], k2[N], k3[N], k4[N], k5[N], k6[N], k7[N], ytmp[N], ynew[N];
+        
+        f(t, y, k1);
+        bool rejected = false;
+        
+        while (t < tend){
+            
+            //Last step ends exactly at tend
+            bool last = false;
+            if (t + h >= tend){
+                h    = tend - t;
+                last = true;
+            }
+            
+            //Stages
+            for (int i = 0; i < N; i++) ytmp[i] = y[i] + h*a21*k1[i];
+            f(t + c2*h, ytmp, k2);
+            for (int i = 0; i < N; i++) ytmp[i] = y[i] + h*(a31*k1[i] + a32*k2[i]);
+            f(t + c3*h, ytmp, k3);
+            for (int i = 0; i < N; i++) ytmp[i] = y[i] + h*(a41*k1[i] + a42*k2[i] + a43*k3[i]);
+            f(t + c4*h, ytmp, k4);
+            for (int i = 0; i < N; i++) ytmp[i] = y[i] + h*(a51*k1[i] + a52*k2[i] + a53*k3[i] + a54*k4[i]);
+            f(t + c5*h, ytmp, k5);
+            for (int i = 0; i < N; i++) ytmp[i] = y[i] + h*(a61*k1[i] + a62*k2[i] + a63*k3[i] + a64*k4[i] + a65*k5[i]);
+            f(t + h, ytmp, k6);
+            for (int i = 0; i < N; i++) ynew[i] = y[i] + h*(a71*k1[i] + a73*k3[i] + a74*k4[i] + a75*k5[i] + a76*k6[i]);
+            f(t + h, ynew, k7);
+            
+            //Error estimate
+            double err = 0.0;
+            for (int i = 0; i < N; i++){
+                const double sk = tolerance + tolerance*std::max(fabs(y[i]), fabs(ynew[i]));
+                const double ei = h*(e1*k1[i] + e3*k3[i] + e4*k4[i] + e5*k5[i] + e6*k6[i] + e7*k7[i])/sk;
+                err += ei*ei;
+            }
+            err = sqrt(err/N);
+            
+            //New step (not larger than the rejected one after a rejection)
+            double fac = (err > 0.0) ? 0.9*pow(err, -0.2) : 5.0;
+            fac = std::min(5.0, std::max(0.2, fac));
+            
+            //Non-finite states are accepted (and reported) as they are; steps are
+            //never made smaller than 1e-10
+            if (err <= 1.0 || err != err || h <= 1e-10){
+                
+                //Dense output coefficients
+                for (int i = 0; i < N; i++){
+                    const double ydiff = ynew[i] - y[i];
+                    const double bspl  = h*k1[i] - ydiff;
+                    rcont1[i] = y[i];
+                    rcont2[i] = ydiff;
+                    rcont3[i] = bspl;
+                    rcont4[i] = ydiff - h*k7[i] - bspl;
+                    rcont5[i] = h*(d1*k1[i] + d3*k3[i] + d4*k4[i] + d5*k5[i] + d6*k6[i] + d7*k7[i]);
+                }
+                t_old = t;
+                t_new = last ? tend : t + h;
+                steps++;
+                
+                const bool proceed = emit(*this, ynew);
+                
+                for (int i = 0; i < N; i++){
+                    y[i]  = ynew[i];
+                    k1[i] = k7[i];
+                }
+                if (!proceed){
+                    return;
+                }
+                t = t_new;
+                if (!last){
+                    h = rejected ? std::min(h, h*fac) : h*fac;
+                }
+                rejected = false;
+            } else {
+                h        = std::max(h*fac, 1e-10);
+                rejected = true;
+            }
+        }
+    }
+    
+    //State at time s in [t_old, t_new] of the last accepted step
+    void dense(double s, double *y) const {
+        const double theta  = (s - t_old)/(t_new - t_old);
+        const double theta1 = 1.0 - theta;
+        for (int i = 0; i < N; i++){
+            y[i] = rcont1[i] + theta*(rcont2[i] + theta1*(rcont3[i] + theta*(rcont4[i] + theta1*rcont5[i])));
+        }
+    }
+    
+private:
+    
+    double rcont1[N], rcont2[N], rcont3[N], rcont4[N], rcont5[N];
+    
+    //Coefficients of the method
+    static constexpr double c2 = 1.0/5.0, c3 = 3.0/10.0, c4 = 4.0/5.0, c5 = 8.0/9.0;
+    static constexpr double a21 = 1.0/5.0;
+    static constexpr double a31 = 3.0/40.0, a32 = 9.0/40.0;
+    static constexpr double a41 = 44.0/45.0, a42 = -56.0/15.0, a43 = 32.0/9.0;
+    static constexpr double a51 = 19372.0/6561.0, a52 = -25360.0/2187.0, a53 = 64448.0/6561.0,
+                            a54 = -212.0/729.0;
+    static constexpr double a61 = 9017.0/3168.0, a62 = -355.0/33.0, a63 = 46732.0/5247.0,
+                            a64 = 49.0/176.0, a65 = -5103.0/18656.0;
+    static constexpr double a71 = 35.0/384.0, a73 = 500.0/1113.0, a74 = 125.0/192.0,
+                            a75 = -2187.0/6784.0, a76 = 11.0/84.0;
+    static constexpr double e1 = 71.0/57600.0, e3 = -71.0/16695.0, e4 = 71.0/1920.0,
+                            e5 = -17253.0/339200.0, e6 = 22.0/525.0, e7 = -1.0/40.0;
+    static constexpr double d1 = -12715105075.0/11282082432.0, d3 = 87487479700.0/32700410799.0,
+                            d4 = -10690763975.0/1880347072.0, d5 = 701980252875.0/199316789632.0,
+                            d6 = -1453857185.0/822651844.0, d7 = 69997945.0/29380423.0;
+};
+
+#endif /* dormand_prince_h */
@@ -0,0 +1,154 @@
+//
+//  dual_number.h
+//
+//  Dual numbers for the forward mode sensitivities of the adult and children
+//  models. A Dual<N> carries a value and its derivatives with respect to N
+//  parameters; every operation applies the chain rule to the derivatives, so
+//  integrating the ODEs with Dual<N> states (whose parameters are seeded with
+//  Dual<N>::variable) gives the derivatives of the trajectories with respect
+//  to each parameter in a single pass.
+//
+//  Only the operations used by the right-hand sides of the models are defined:
+//  +, -, *, / (with duals and doubles), exp and pow with a double exponent.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef dual_number_h
+#define dual_number_h
+
+#include <math.h>
+
+template <int N>
+class Dual {
+public:
+    
+    double v;     //Value
+    double d[N];  //Derivatives with respect to each parameter
+    
+    //Constant (no derivatives)
+    Dual(double value = 0.0) : v(value) {
+        for (int i = 0; i < N; i++) d[i] = 0.0;
+    }
+    
+    //Parameter i with the given value (derivative 1 with respect to itself)
+    static Dual variable(double value, int i){
+        Dual x(value);
+        x.d[i] = 1.0;
+        return x;
+    }
+    
+    friend Dual operator-(const Dual &a){
+        Dual x(-a.v);
+        for (int i = 0; i < N; i++) x.d[i] = -a.d[i];
+        return x;
+    }
+    
+    friend Dual operator+(const Dual &a, const Dual &b){
+        Dual x(a.v + b.v);
+        for (int i = 0; i < N; i++) x.d[i] = a.d[i] + b.d[i];
+        return x;
+    }
+    friend Dual operator+(const Dual &a, double b){
+        Dual x(a);
+        x.v += b;
+        return x;
+    }
+    friend Dual operator+(double a, const Dual &b){
+        return b + a;
+    }
+    
+    friend Dual operator-(const Dual &a, const Dual &b){
+        Dual x(a.v - b.v);
+        for (int i = 0; i < N; i++) x.d[i] = a.d[i] - b.d[i];
+        return x;
+    }
+    friend Dual operator-(const Dual &a, double b){
+        Dual x(a);
+        x.v -= b;
+        return x;
+    }
+    friend Dual operator-(double a, const Dual &b){
+        Dual x(a - b.v);
+        for (int i = 0; i < N; i++) x.d[i] = -b.d[i];
+        return x;
+    }
+    
+    friend Dual operator*(const Dual &a, const Dual &b){
+        Dual x(a.v * b.v);
+        for (int i = 0; i < N; i++) x.d[i] = a.d[i]*b.v + a.v*b.d[i];
+        return x;
+    }
+    friend Dual operator*(const Dual &a, double b){
+        Dual x(a.v * b);
+        for (int i = 0; i < N; i++) x.d[i] = a.d[i]*b;
+        return x;
+    }
+    friend Dual operator*(double a, const Dual &b){
+        return b * a;
+    }
+    
+    friend Dual operator/(const Dual &a, const Dual &b){
+        const double inv = 1.0/b.v;
+        Dual x(a.v * inv);
+        for (int i = 0; i < N; i++) x.d[i] = (a.d[i] - x.v*b.d[i])*inv;
+        return x;
+    }
+    friend Dual operator/(const Dual &a, double b){
+        Dual x(a.v / b);
+        for (int i = 0; i < N; i++) x.d[i] = a.d[i]/b;
+        return x;
+    }
+    friend Dual operator/(double a, const Dual &b){
+        const double inv = 1.0/b.v;
+        Dual x(a * inv);
+        for (int i = 0; i < N; i++) x.d[i] = -x.v*b.d[i]*inv;
+        return x;
+    }
+    
+    friend Dual exp(const Dual &a){
+        Dual x(::exp(a.v));
+        for (int i = 0; i < N; i++) x.d[i] = x.v*a.d[i];
+        return x;
+    }
+    
+    friend Dual pow(const Dual &a, double p){
+        Dual x(::pow(a.v, p));
+        const double slope = p*::pow(a.v, p - 1.0);
+        for (int i = 0; i < N; i++) x.d[i] = slope*a.d[i];
+        return x;
+    }
+};
+
+//Value of a double or of a dual
+inline double value(double x){
+    return x;
+}
+
+template <int N>
+inline double value(const Dual<N> &x){
+    return x.v;
+}
+
+#endif /* dual_number_h */
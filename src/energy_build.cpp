@@ -11,6 +11,10 @@
 //  otherwise the model does not make any sense.
 //  interpol .- Interpolation mode: linear, exponential, stepwise_r, stepwise_l, 
 //  brownian and logarihmmic.
+//  threads  .- Number of threads used for the brownian bridge when seed is given.
+//  seed     .- Seed of the counter-based (Philox4x32-10) normal draws of the brownian
+//  bridge. Each individual and day has its own counter so the bridge is reproducible
+//  for any number of threads. If NA, R's random number generator is used instead.
 //
 //  Authors:
 //  Dalia Camacho-García-Formentí
@@ -37,76 +41,225 @@
 
 #include <Rcpp.h>
 #include <math.h>
+#include <vector>
+#include <stdint.h>
+#include "energy_knots.h"
+#include "profile.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace Rcpp;
 
+//Rows of Evalues generated together by a thread for the brownian bridge
+static const int chunk_size = 256;
+
+//Philox4x32-10 counter-based generator (Salmon et al. 2011, Random123)
+static inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]){
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++){
+    const uint64_t p0 = (uint64_t) 0xD2511F53u*c0;
+    const uint64_t p1 = (uint64_t) 0xCD9E8D57u*c2;
+    const uint32_t hi0 = p0 >> 32, lo0 = (uint32_t) p0;
+    const uint32_t hi1 = p1 >> 32, lo1 = (uint32_t) p1;
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+  out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+//Standard normal for individual k at day d: each Philox block gives two
+//uniforms in (0, 1) with 53 bits and two normals (Box-Muller) for days 2b, 2b + 1
+static inline double philoxNormal(const uint32_t key[2], int k, int d){
+  const uint32_t counter[4] = {(uint32_t) (d >> 1), (uint32_t) k, 0u, 0u};
+  uint32_t x[4];
+  philox4x32(counter, key, x);
+  const double u1 = ((x[0] >> 5)*67108864.0 + (x[1] >> 6) + 0.5)/9007199254740992.0;
+  const double u2 = ((x[2] >> 5)*67108864.0 + (x[3] >> 6) + 0.5)/9007199254740992.0;
+  const double r  = sqrt(-2.0*log(u1));
+  return (d & 1) ? r*sin(2.0*M_PI*u2) : r*cos(2.0*M_PI*u2);
+}
+
+//Brownian bridge between knots t and T for rows first, ..., last - 1 with the
+//counter-based normals. As in brownianInterval columns t, ..., T of out first hold
+//the path W of each row and then the bridge.
+static void brownianPhilox(const double *E0, const double *E1, double *out, int nrow,
+                           int first, int last, double t, double T, const uint32_t key[2]){
+  
+  const int n = T - t;
+  double *W0  = out + (std::size_t) t*nrow;
+  double *Wn  = W0 + (std::size_t) n*nrow;
+  
+  //Simulate W brownian path (W(0) = 0)
+  for (int k = first; k < last; k++){
+    W0[k] = 0.0;
+  }
+  for (int i = 1; i < (T - t + 1); i++){
+    double       *Wi   = W0 + (std::size_t) i*nrow;
+    const double *Wim1 = Wi - nrow;
+    for (int k = first; k < last; k++){
+      Wi[k] = Wim1[k] + philoxNormal(key, k, t + i);
+    }
+  }
+  
+  //Get brownian bridge
+  for (int i = 0 ; i < (T - t + 1); i++){
+    double *Wi = W0 + (std::size_t) i*nrow;
+    for (int k = first; k < last; k++){
+      Wi[k] = E0[k]*( (T - t) - i )/(T - t) + E1[k]*i/(T-t) + Wi[k] -  (i/(T-t))*Wn[k];
+    }
+  }
+}
+
+//Brownian bridge between knots j and j + 1 written in place: columns t, ..., T
+//of out first hold the Brownian path W and then the bridge. Normal draws follow
+//the same order as rnorm(nrow) for each day.
+static void brownianInterval(const double *E0, const double *E1, double *out, int nrow,
+                             double t, double T){
+  
+  const int n = T - t;
+  double *W0  = out + (std::size_t) t*nrow;
+  double *Wn  = W0 + (std::size_t) n*nrow;
+  
+  //Simulate W brownian path (W(0) = 0)
+  for (int k = 0; k < nrow; k++){
+    W0[k] = 0.0;
+  }
+  for (int i = 1; i < (T - t + 1); i++){
+    double       *Wi   = W0 + (std::size_t) i*nrow;
+    const double *Wim1 = Wi - nrow;
+    for (int k = 0; k < nrow; k++){
+      Wi[k] = Wim1[k] + R::norm_rand();
+    }
+  }
+  
+  //Get brownian bridge (same operations as the path of rnorm vectors)
+  for (int i = 0 ; i < (T - t + 1); i++){
+    double *Wi = W0 + (std::size_t) i*nrow;
+    for (int k = 0; k < nrow; k++){
+      Wi[k] = E0[k]*( (T - t) - i )/(T - t) + E1[k]*i/(T-t) + Wi[k] -  (i/(T-t))*Wn[k];
+    }
+  }
+}
+
 // [[Rcpp::export]]
 NumericMatrix EnergyBuilder(NumericMatrix Energy, NumericVector Time, 
-                            std::string interpol){
+                            std::string interpol, int threads, double seed){
   
-
+  BW_PROFILE_START(threads, "setup");
+  
+  //Method is resolved once
+  const Interpolation method = getInterpolation(interpol);
   
   //Number of times to calculate
-  int days = floor(Time(Time.size()-1));
-  int j    = 0; //indicator of time value we are taking
+  const int days = floor(Time(Time.size()-1));
+  const int nrow = Energy.nrow();
   
   //Numeric matrix to return
-  NumericMatrix Evalues(Energy.nrow(), days + 1);
+  NumericMatrix Evalues(nrow, days + 1);
+  BW_PROFILE_BYTES((double) Evalues.size()*sizeof(double));
   
-  double K = 5000; //To avoid logarithm starting at 0 we displace the exponential to let for a maximum y2 - y1 of 1000.
+  const double K    = energy_K;
+  const double logK = log(K);
   
-  //Brownian bridge
-  if (interpol.compare("Brownian") == 0){
-   
-   for (int j = 0; j < (Time.size()-1); j++){
-     
-     //Get times
-     double T = Time(j+1);
-     double t = Time(j);
-     
-     //Simulate W brownian path
-     NumericMatrix W(Energy.nrow(), (T - t) + 1); //By default W(_, 0) = 0;
-     for (int i = 1; i < (T - t + 1); i++){
-       W(_, i) = W(_,i-1) + rnorm(Energy.nrow());
-     }
-     
-     //Get brownian bridge
-     for (int i = 0 ; i < (T - t + 1); i++){
-       Evalues(_,i + t) = Energy(_,j)*( (T - t) - i )/(T - t) + Energy(_,j+1)*i/(T-t) + 
-         W(_, i) -  (i/(T-t))*W(_, (T-t));  
-     }
-   }
-   
+  //Columns are contiguous in column-major order
+  const double *E   = Energy.begin();
+  double       *out = Evalues.begin();
+  BW_PROFILE_PHASE("interpolate");
+  
+  //Brownian bridge with counter-based draws (rows are independent)
+  if (method == BROWNIAN && !ISNAN(seed)){
+    
+    const uint64_t seed64 = (uint64_t) seed;
+    const uint32_t key[2] = {(uint32_t) seed64, (uint32_t) (seed64 >> 32)};
+    const int nchunks     = (nrow + chunk_size - 1)/chunk_size;
+    const int nknots      = Time.size();
+    const double *time    = Time.begin();
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1)
+#endif
+    for (int c = 0; c < nchunks; c++){
+      BW_PROFILE_CHUNK();
+      for (int j = 0; j < (nknots-1); j++){
+        brownianPhilox(E + (std::size_t) j*nrow, E + (std::size_t) (j + 1)*nrow, out, nrow,
+                       c*chunk_size, std::min(nrow, (c + 1)*chunk_size), time[j], time[j+1], key);
+      }
+    }
+    
+  //Brownian bridge with R's random number generator
+  } else if (method == BROWNIAN){
+    
+    for (int j = 0; j < (Time.size()-1); j++){
+      brownianInterval(E + (std::size_t) j*nrow, E + (std::size_t) (j + 1)*nrow, out, nrow,
+                       Time(j), Time(j+1));
+    }
+    
   } else {
     
-    //Case; exponential; logarithmic or stepwise
-    for (int i = 0; i < days; i++){
+    //Coefficient of each individual in the current interval
+    std::vector<double> coef(nrow);
+    
+    //Walk the knot intervals: interval j covers days Time(j) <= i < Time(j+1)
+    int i = 0;
+    for (int j = 0; j < (Time.size()-1) && i < days; j++){
       
-      //Linear case
-      if (interpol.compare("Linear") == 0){
-        Evalues(_,i) =  (Energy(_, j + 1) - Energy(_, j))/(Time(j+1) - Time(j))*(i - Time(j)) + 
-          Energy(_, j);
-      } else if (interpol.compare("Stepwise_L") == 0){
-        Evalues(_,i) = Energy(_,j);
-      } else if (interpol.compare("Stepwise_R") == 0){
-        Evalues(_,i) = Energy(_,j+1);
-      } else if (interpol.compare("Exponential") == 0){
-        Evalues(_,i) =  exp((log(Energy(_, j + 1) - Energy(_, j) + K) - log(K))/(Time(j+1) - Time(j))*(i - Time(j)) + log(K)) - K + Energy(_, j);
-      } else if (interpol.compare("Logarithmic") == 0){
-        Evalues(_,i) =  1000*log( (exp( (Energy(_, j + 1) - Energy(_, j))/1000) -1)/(Time(j+1) - Time(j))*(i - Time(j)) + 1) + Energy(_,j);
-      } 
+      const double *E0 = E + (std::size_t) j*nrow;
+      const double *E1 = E0 + nrow;
+      const double  t  = Time(j);
+      const double  dT = Time(j+1) - Time(j);
       
-      //Update to next time
-      if (i + 1 >= Time(j + 1)){
-          j = j + 1;  
+      for (int k = 0; k < nrow; k++){
+        coef[k] = interpolationCoefficient(method, E0[k], E1[k], dT);
       }
       
+      for (; i < days && i < Time(j+1); i++){
+        
+        double      *Ei = out + (std::size_t) i*nrow;
+        const double x  = i - t;
+        
+        switch (method){
+          case LINEAR:
+            for (int k = 0; k < nrow; k++){
+              Ei[k] = coef[k]*x + E0[k];
+            }
+            break;
+          case EXPONENTIAL:
+            for (int k = 0; k < nrow; k++){
+              Ei[k] = exp(coef[k]*x + logK) - K + E0[k];
+            }
+            break;
+          case LOGARITHMIC:
+            for (int k = 0; k < nrow; k++){
+              Ei[k] = 1000*log(coef[k]*x + 1) + E0[k];
+            }
+            break;
+          case STEPWISE_L:
+            for (int k = 0; k < nrow; k++){
+              Ei[k] = E0[k];
+            }
+            break;
+          default:
+            for (int k = 0; k < nrow; k++){
+              Ei[k] = E1[k];
+            }
+            break;
+        }
+      }
     }
     
     //Last day
-    Evalues(_, Evalues.ncol() - 1) = Energy(_,Energy.ncol() - 1);
+    const double *Elast = E + (std::size_t) (Energy.ncol() - 1)*nrow;
+    double       *Olast = out + (std::size_t) days*nrow;
+    for (int k = 0; k < nrow; k++){
+      Olast[k] = Elast[k];
+    }
     
   }
   
-  
+  BW_PROFILE_ATTACH(Evalues);
   return Evalues;
 }
@@ -0,0 +1,95 @@
+//
+//  energy_knots.cpp
+//
+//  This is a class that evaluates the interpolation of energy_build on demand.
+//  Instead of materialising the days x nind matrix given by EnergyBuilder, the
+//  models keep the knots (Energy, Time) and the interpolation coefficients of
+//  each interval, and get the value of an individual at a given day when an
+//  RK stage needs it. Values coincide with the columns of EnergyBuilder.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "energy_knots.h"
+
+Interpolation getInterpolation(std::string interpol){
+    if (interpol == "Linear"){
+        return LINEAR;
+    } else if (interpol == "Exponential"){
+        return EXPONENTIAL;
+    } else if (interpol == "Logarithmic"){
+        return LOGARITHMIC;
+    } else if (interpol == "Stepwise_L"){
+        return STEPWISE_L;
+    } else if (interpol == "Stepwise_R"){
+        return STEPWISE_R;
+    } else if (interpol == "Brownian"){
+        return BROWNIAN;
+    }
+    stop("Invalid interpolation " + interpol);
+    return LINEAR;
+}
+
+EnergyKnots::EnergyKnots(void){
+    active = false;
+    days   = 0;
+    E      = NULL;
+    time   = NULL;
+    nrow   = 0;
+    nknots = 0;
+    method = LINEAR;
+    logK   = log(energy_K);
+}
+
+EnergyKnots::EnergyKnots(List knots){
+    
+    Energy = as<NumericMatrix>(knots["energy"]);
+    Time   = as<NumericVector>(knots["time"]);
+    method = getInterpolation(as<std::string>(knots["interpolation"]));
+    if (method == BROWNIAN){
+        stop("Brownian interpolation can't be evaluated on demand. Please use energy_build.");
+    }
+    
+    active = true;
+    E      = Energy.begin();
+    time   = Time.begin();
+    nrow   = Energy.nrow();
+    nknots = Time.size();
+    days   = floor(Time(nknots - 1));
+    logK   = log(energy_K);
+    
+    //Interval j covers days Time(j) <= i < Time(j+1) (as in EnergyBuilder)
+    interval.resize(days);
+    coef.resize((std::size_t) nrow*std::max(nknots - 1, 0));
+    int i = 0;
+    for (int j = 0; j < (nknots - 1); j++){
+        const double dT = Time(j+1) - Time(j);
+        for (int k = 0; k < nrow; k++){
+            coef[(std::size_t) j*nrow + k] = interpolationCoefficient(method,
+                    E[(std::size_t) j*nrow + k], E[(std::size_t) (j + 1)*nrow + k], dT);
+        }
+        for (; i < days && i < Time(j+1); i++){
+            interval[i] = j;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+//
+//  energy_knots.h
+//
+//  This is a class that evaluates the interpolation of energy_build on demand.
+//  Instead of materialising the days x nind matrix given by EnergyBuilder, the
+//  models keep the knots (Energy, Time) and the interpolation coefficients of
+//  each interval, and get the value of an individual at a given day when an
+//  RK stage needs it. Values coincide with the columns of EnergyBuilder.
+//
+//  INPUT:
+//  Energy   .- Energy at each knot, where each row is an individual and each column
+//  is a time in Time.
+//  Time     .- Vector of knot times (integer days, first element 0).
+//  interpol .- Interpolation mode: linear, exponential, stepwise_r, stepwise_l and
+//  logarithmic. The brownian bridge needs the whole path of each interval so it is
+//  only available through EnergyBuilder.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef energy_knots_h
+#define energy_knots_h
+
+#include <math.h>
+#include <vector>
+#include <string>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+//Interpolation methods (resolved once from the string)
+enum Interpolation {LINEAR, EXPONENTIAL, LOGARITHMIC, STEPWISE_L, STEPWISE_R, BROWNIAN};
+
+Interpolation getInterpolation(std::string interpol);
+
+//To avoid logarithm starting at 0 we displace the exponential to let for a maximum y2 - y1 of 1000.
+static const double energy_K = 5000;
+
+//Coefficient of an individual in the interval from E0 to E1 of length dT
+inline double interpolationCoefficient(Interpolation method, double E0, double E1, double dT){
+    if (method == LINEAR){
+        return (E1 - E0)/dT;
+    } else if (method == EXPONENTIAL){
+        return (log(E1 - E0 + energy_K) - log(energy_K))/dT;
+    } else if (method == LOGARITHMIC){
+        return (exp( (E1 - E0)/1000) -1)/dT;
+    }
+    return 0.0;
+}
+
+class EnergyKnots {
+public:
+    
+    //Empty knots (the model reads its input matrix instead)
+    EnergyKnots(void);
+    
+    //knots: list with energy (matrix), time (vector) and interpolation (string)
+    EnergyKnots(List knots);
+    
+    //Whether the knots are used
+    bool active;
+    
+    //Days covered by the knots (floor of the last element of Time)
+    int days;
+    
+    //Value of individual j at day i (column i of EnergyBuilder; days after the
+    //last knot keep its energy)
+    inline double value(int i, int j) const {
+        if (i >= days){
+            return E[(std::size_t) (nknots - 1)*nrow + j];
+        }
+        const int     k  = interval[i];
+        const double  E0 = E[(std::size_t) k*nrow + j];
+        const double  x  = i - time[k];
+        switch (method){
+            case LINEAR:
+                return coef[(std::size_t) k*nrow + j]*x + E0;
+            case EXPONENTIAL:
+                return exp(coef[(std::size_t) k*nrow + j]*x + logK) - energy_K + E0;
+            case LOGARITHMIC:
+                return 1000*log(coef[(std::size_t) k*nrow + j]*x + 1) + E0;
+            case STEPWISE_L:
+                return E0;
+            default:
+                return E[(std::size_t) (k + 1)*nrow + j];
+        }
+    }
+    
+private:
+    
+    NumericMatrix       Energy;
+    NumericVector       Time;
+    Interpolation       method;
+    const double       *E;
+    const double       *time;
+    int                 nrow;
+    int                 nknots;
+    double              logK;
+    std::vector<int>    interval;   //Knot interval of each day
+    std::vector<double> coef;       //Coefficient of each individual and interval
+};
+
+#endif /* energy_knots_h */
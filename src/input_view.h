@@ -0,0 +1,117 @@
+//
+//  input_view.h
+//
+//  This is a class that reads an input matrix of the models (the intake changes
+//  and physical activity of the adults and the intake of the children) without
+//  materialising it for every individual and time step. A matrix with a single
+//  row (or column) of individuals gives the same input to every individual and
+//  one with a single time step gives the same input at every time, so a constant
+//  PAL of a population is a 1 x 1 matrix instead of an nind x days one. Values
+//  are read through strides that are 0 for the dimensions that are shared.
+//
+//  INPUT:
+//  input .- Matrix with either a row per individual and a column per time step
+//  (rows = true, the inputs of Adult) or a row per time step and a column per
+//  individual (rows = false, the intake of Child). Either dimension may be 1.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef input_view_h
+#define input_view_h
+
+#include <cstddef>
+#include <algorithm>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class InputView {
+public:
+
+    //Empty view (every value is 0)
+    InputView(void){
+        x           = none();
+        step_stride = 0;
+        ind_stride  = 0;
+        steps       = 0;
+    }
+
+    //View of input with individuals in its rows (rows = true) or in its columns
+    InputView(NumericMatrix input, bool rows){
+        matrix = input;
+        x      = (matrix.size() > 0) ? matrix.begin() : none();
+        const int nrow = matrix.nrow();
+        const int ncol = matrix.ncol();
+        const int nt   = rows ? ncol : nrow;   //Time steps
+        const int ni   = rows ? nrow : ncol;   //Individuals
+        steps       = (nt > 1) ? nt : 0;
+        step_stride = (nt > 1) ? (rows ? nrow : 1) : 0;
+        ind_stride  = (ni > 1) ? (rows ? 1 : nrow) : 0;
+    }
+
+    //Time steps of the input (0 if it is the same at every time step)
+    int steps;
+
+    //Value of individual j at time step i
+    inline double value(int i, int j) const {
+        return x[(std::size_t) i*step_stride + (std::size_t) j*ind_stride];
+    }
+
+    //Values of individuals 0, ..., n - 1 at time step i
+    NumericVector values(int i, int n) const {
+        NumericVector v(n);
+        for (int j = 0; j < n; j++){
+            v[j] = value(i, j);
+        }
+        return v;
+    }
+
+private:
+
+    NumericMatrix matrix;
+    const double *x;
+    std::size_t   step_stride;
+    std::size_t   ind_stride;
+
+    //Value read by empty views (views are copied so it is not a member)
+    static const double *none(void){
+        static const double zero = 0.0;
+        return &zero;
+    }
+};
+
+//Time steps of the views a, b and c of the inputs of a model: those of the views
+//that change over time (the smallest one) or 0 if none does
+inline int inputSteps(const InputView &a, const InputView &b, const InputView &c){
+    int steps = 0;
+    const int views[3] = {a.steps, b.steps, c.steps};
+    for (int v = 0; v < 3; v++){
+        if (views[v] > 0){
+            steps = (steps > 0) ? std::min(steps, views[v]) : views[v];
+        }
+    }
+    return steps;
+}
+
+#endif /* input_view_h */
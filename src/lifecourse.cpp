@@ -0,0 +1,253 @@
+//
+//  lifecourse.cpp
+//
+//  This is a class that integrates a population of children (and adults) over
+//  their lifecourse in a single run. Each child is integrated with the fused
+//  engine of the children model (see child_weight.cpp) until the step at which
+//  its age reaches the transition age. The adult model (see adult_weight.cpp)
+//  starts from the state of each child at that step:
+//
+//  bw  = FFM + FM at the transition
+//  fat = FM at the transition
+//  age = age at the transition
+//  EI  = intake of the child at the transition (EIchange is added to it)
+//
+//  with K at the steady state of the PAL of the step of the transition. The
+//  steps of both models are reported to a single output (see model_output.h)
+//  with the variables they share: Age, Fat_Mass, Body_Weight and Energy_Intake.
+//  Individuals cross at different steps so the adults of a chunk join its loop
+//  at their own step (see Adult::start_ptr).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "lifecourse.h"
+#include "profile.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Individuals integrated together by a thread (as in the children and adult models)
+static const int chunk_size = 256;
+
+//Variables reported by both models
+static const char *lifecourse_variables[] = {"Age", "Fat_Mass", "Body_Weight", "Energy_Intake"};
+
+Lifecourse::Lifecourse(Child &input_child, NumericVector input_ht, NumericMatrix input_EIchange,
+                       NumericMatrix input_NAchange, NumericMatrix input_PAL,
+                       NumericVector input_pcarb_base, NumericVector input_pcarb,
+                       double input_transition, bool checkValues) : child(input_child){
+    ht         = input_ht;
+    EIchange   = input_EIchange;
+    NAchange   = input_NAchange;
+    PAL        = input_PAL;
+    pcarb_base = input_pcarb_base;
+    pcarb      = input_pcarb;
+    transition = input_transition;
+    check      = checkValues;
+    nsteps     = 0;
+}
+
+Lifecourse::~Lifecourse(void){
+    
+}
+
+//Method of the adults
+void Lifecourse::setSolver(List input_solver){
+    solver = input_solver;
+}
+
+//Children or adults (adult not NULL) of first, ..., end - 1
+void Lifecourse::integrateChunk(Adult *adult, int first, int end, ModelOutput &out,
+                                ModelOutputPartial &part){
+    
+    if (adult){
+        adult->integrateChunk(first, end, nsteps, TIME.begin(), out, part);
+        return;
+    }
+    
+    //Baseline of the children (and of those that are already adults) and the
+    //steps of the chunk until its last child becomes an adult
+    BW_PROFILE_CHUNK();
+    ChildHandoff handoff = {last.data(), vars, state.data(), out, part};
+    int nsims = 0;
+    for (int j = first; j < end; j++){
+        handoff.record(0, j, child.age[j], child.FFM[j], child.FM[j],
+                       child.Intake(child.age[j], 0, j));
+        nsims = std::max(nsims, last[j]);
+    }
+    child.integrateHandoff(first, end, nsims, rows.data(), handoff);
+}
+
+//Every individual by chunks. When summarising, chunk accumulators are merged in
+//chunk order so the summary does not depend on the number of threads.
+void Lifecourse::integrate(Adult *adult, ModelOutput &out, int threads){
+    const int nchunks = (child.nind + chunk_size - 1)/chunk_size;
+    if (out.reduces()){
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(std::max(threads, 1))
+#endif
+        {
+            ModelOutputPartial part = out.partial();
+#ifdef _OPENMP
+            #pragma omp for ordered schedule(static, 1)
+#endif
+            for (int c = 0; c < nchunks; c++){
+                part.reset();
+                integrateChunk(adult, c*chunk_size, std::min(child.nind, (c + 1)*chunk_size),
+                               out, part);
+#ifdef _OPENMP
+                #pragma omp ordered
+#endif
+                out.merge(part);
+            }
+        }
+    } else {
+        ModelOutputPartial part;
+#ifdef _OPENMP
+        #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1) firstprivate(part)
+#endif
+        for (int c = 0; c < nchunks; c++){
+            integrateChunk(adult, c*chunk_size, std::min(child.nind, (c + 1)*chunk_size), out, part);
+        }
+    }
+}
+
+//Rungue Kutta 4 of the children up to their transition and of the adults from
+//it. output is the same list as in rk4_fused of Adult (vars, stride, summary,
+//group, weights, strata and optionally precision, resolution and path) with
+//vars among Age, Fat_Mass, Body_Weight and Energy_Intake. Returns the reported
+//times and variables, the time at which each individual becomes an adult
+//(Transition, NA if it is a child until the end) and the Model_Type.
+List Lifecourse::rk4_fused(double days, int threads, List output){
+    
+    std::vector<std::string> outvars = as< std::vector<std::string> >(output["vars"]);
+    const int         stride      = as<int>(output["stride"]);
+    const std::string summary     = as<std::string>(output["summary"]);
+    IntegerVector     group       = as<IntegerVector>(output["group"]);
+    NumericVector     weights     = as<NumericVector>(output["weights"]);
+    IntegerVector     strata      = as<IntegerVector>(output["strata"]);
+    const std::string precision   = output.containsElementNamed("precision") ? as<std::string>(output["precision"]) : "double";
+    List              resolution  = output.containsElementNamed("resolution") ? as<List>(output["resolution"]) : List();
+    const std::string path        = output.containsElementNamed("path") ? as<std::string>(output["path"]) : "";
+    BW_PROFILE_PHASE("setup");
+    if (child.adaptive){
+        stop("Invalid method. Lifecourse runs require method = 'RK4'.");
+    }
+    
+    //Time steps from baseline (the adult inputs have a column for each one or a
+    //single one for all of them, see Adult::inputSteps)
+    const int       nind    = child.nind;
+    const double    dt      = child.dt;
+    const InputView PALview(PAL, true);
+    const int       columns = inputSteps(InputView(EIchange, true), InputView(NAchange, true),
+                                         PALview);
+    nsteps = std::min(floor(days/dt), (columns > 0 ? columns : ceil(days/dt)) - 1.0);
+    if (nsteps < 0){
+        stop("Invalid days. Please make sure days > 0.");
+    }
+    TIME = NumericVector(nsteps + 1);
+    TIME(0) = 0.0;
+    for (int i = 1; i <= nsteps; i++){
+        TIME(i) = TIME(i-1) + dt;
+    }
+    
+    //Both models report to the variables of the adult model
+    std::vector<std::string> available = Adult::variables();
+    for (std::size_t v = 0; v < outvars.size(); v++){
+        if (std::find(lifecourse_variables, lifecourse_variables + 4, outvars[v]) == lifecourse_variables + 4){
+            stop("Invalid vars. Please specify any of the following: 'Age', 'Fat_Mass', 'Body_Weight', 'Energy_Intake'.");
+        }
+    }
+    for (int v = 0; v < 4; v++){
+        vars[v] = std::find(available.begin(), available.end(), lifecourse_variables[v]) - available.begin();
+    }
+    ModelOutput out(available, outvars, stride, nsteps, nind, summary, group, weights, strata,
+                    1, List(), precision, getResolution(resolution, available), path);
+    
+    //Step at which each individual becomes an adult: the first one at which its
+    //age reaches the transition (0 for adults at baseline). Those that are still
+    //children at the end are integrated up to the last step.
+    NumericVector Transition(nind);
+    last.assign(nind, 0);
+    origin.assign(nind, 0.0);
+    state.assign((std::size_t) 4*nind, NA_REAL);
+    int nchild = 0;
+    for (int j = 0; j < nind; j++){
+        const double s = std::max(ceil(365.0*(transition - child.age[j])/dt), 0.0);
+        last[j]        = (int) std::min(s, (double) nsteps);
+        origin[j]      = TIME[last[j]];
+        Transition[j]  = (s <= nsteps) ? TIME[last[j]] : NA_REAL;
+        nchild         = std::max(nchild, last[j]);
+    }
+    
+    //Children with the rows of EIntake and the terms of their cohorts of
+    //Child::rk4_fused (up to the last transition)
+    child.intakeRows(nsteps, rows);
+    BW_PROFILE_PHASE("tables");
+    child.buildTables(nchild, threads);
+    BW_PROFILE_PHASE("integrate");
+    child.failed.assign(nind, -1);
+    integrate(NULL, out, threads);
+    std::vector<double>().swap(child.table);
+    
+    //Adults from the state of each child at its transition
+    BW_PROFILE_PHASE("build");
+    NumericVector bw(nind), fat(nind), age(nind), EI(nind), PAL_base(nind);
+    for (int j = 0; j < nind; j++){
+        age[j]      = state[4*j];
+        bw[j]       = state[4*j + 1] + state[4*j + 2];
+        fat[j]      = state[4*j + 2];
+        EI[j]       = state[4*j + 3];
+        PAL_base[j] = PALview.value(last[j], j);
+    }
+    Adult adult(bw, ht, age, child.sex, EIchange, NAchange, PAL, pcarb, pcarb_base, dt, EI,
+                fat, check);
+    adult.getK(PAL_base);
+    adult.getBuffers();
+    if (solver.size() > 0){
+        adult.setSolver(solver);
+    }
+    adult.start_ptr  = last.data();
+    adult.origin_ptr = origin.data();
+    adult.halt       = child.halt;
+    adult.failed.assign(nind, -1);
+    BW_PROFILE_PHASE("integrate");
+    integrate(&adult, out, threads);
+    
+    //First invalid step of each individual (that of the child if it failed as a
+    //child, whose invalid state is the baseline of the adult)
+    std::vector<int> failed(nind);
+    for (int j = 0; j < nind; j++){
+        failed[j] = (child.failed[j] >= 0) ? child.failed[j] : adult.failed[j];
+    }
+    
+    BW_PROFILE_PHASE("wrap");
+    List results = out.wrap(TIME);
+    results.push_back(Transition, "Transition");
+    out.validity(results, failed, TIME);
+    results.push_back("Lifecourse", "Model_Type");
+    
+    return results;
+}
@@ -0,0 +1,124 @@
+//
+//  lifecourse.h
+//
+//  This is a class that integrates children with the children model until they
+//  reach the transition age and continues with the adult model from their
+//  state at that step, in a single run (see lifecourse.cpp)
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef lifecourse_h
+#define lifecourse_h
+
+#include <vector>
+#include <Rcpp.h>
+#include "child_weight.h"
+#include "adult_weight.h"
+#include "model_output.h"
+using namespace Rcpp;
+
+//Output of the fused engine of the children of a lifecourse run. Child j is
+//integrated up to step last[j], at which it becomes an adult, and its steps are
+//reported to the variables vars (Age, Fat_Mass, Body_Weight and Energy_Intake of
+//out). Its age, FFM, FM and intake at step last[j] are kept in state[4 j], ...,
+//state[4 j + 3] as the baseline of the adult model.
+//--------------------------------------------------------------------------------
+struct ChildHandoff {
+    const int          *last;
+    const int          *vars;
+    double             *state;
+    ModelOutput        &out;
+    ModelOutputPartial &part;
+    
+    int  steps(int j) const { return last[j]; }
+    void record(int i, int j, double AGE, double FFM, double FM, double intake){
+        const int r = out.report[i];
+        if (r >= 0){
+            out.put(vars[0], r, j, AGE, part);
+            out.put(vars[1], r, j, FM, part);
+            out.put(vars[2], r, j, FFM + FM, part);
+            out.put(vars[3], r, j, intake, part);
+        }
+        if (i == last[j]){
+            state[4*j]     = AGE;
+            state[4*j + 1] = FFM;
+            state[4*j + 2] = FM;
+            state[4*j + 3] = intake;
+        }
+    }
+    void record(int i, int j, double AGE, double FFM, double FM, const ChildTimeTerms &c){
+        record(i, j, AGE, FFM, FM, c.intake);
+    }
+};
+
+//Create a Lifecourse class with the children and the inputs of their adult years
+//--------------------------------------------------------------------------------
+class Lifecourse {
+public:
+    
+    //child is the population at baseline (individuals already older than the
+    //transition age start as adults with its FFM and FM). ht and the rest of the
+    //inputs are those of the adult model (see Adult) whose columns are the time
+    //steps from baseline (an individual only uses those after its transition).
+    Lifecourse(Child &input_child, NumericVector input_ht, NumericMatrix input_EIchange,
+               NumericMatrix input_NAchange, NumericMatrix input_PAL,
+               NumericVector input_pcarb_base, NumericVector input_pcarb,
+               double input_transition, bool checkValues);
+    ~Lifecourse(void);
+    
+    //Integration method of the adults (see setSolver of Adult; the children
+    //are always integrated by RK4)
+    void setSolver(List solver);
+    
+    //Integrate days from baseline (see rk4_fused of Adult for output)
+    List rk4_fused(double days, int threads, List output);
+    
+private:
+    
+    Child         &child;
+    NumericVector  ht;
+    NumericMatrix  EIchange;
+    NumericMatrix  NAchange;
+    NumericMatrix  PAL;
+    NumericVector  pcarb_base;
+    NumericVector  pcarb;
+    double         transition;  //Age (yrs) at which children become adults
+    bool           check;
+    List           solver;      //Method of the adults (RK4 if empty)
+    
+    //State of a run
+    int                 nsteps;    //Time steps from baseline
+    NumericVector       TIME;      //Time (days) of each step
+    std::vector<int>    rows;      //Rows of EIntake at each stage (see Child::intakeRows)
+    std::vector<int>    last;      //Step at which each individual becomes an adult
+    std::vector<double> origin;    //TIME of that step
+    std::vector<double> state;     //Age, FFM, FM and intake of each individual at that step
+    int                 vars[4];   //Age, Fat_Mass, Body_Weight and Energy_Intake of the output
+    
+    void integrate(Adult *adult, ModelOutput &out, int threads);
+    void integrateChunk(Adult *adult, int first, int end, ModelOutput &out,
+                        ModelOutputPartial &part);
+};
+
+#endif /* lifecourse_h */
@@ -0,0 +1,102 @@
+//
+//  lifecourse_wrapper.cpp
+//
+//  This is a function that integrates children until the transition age and
+//  continues as adults (see lifecourse.h) with inputs from R:
+//
+//  INPUTS:
+//  age, sex, bmiCat, .-  Baseline of the children as in child_weight_wrapper
+//  FFM, FM
+//  input_EIntake     .-  Energy intake of the children (or the parameters of
+//                        Richards curve for lifecourse_weight_wrapper_richardson)
+//  ht                .-  Height (m) of each individual as an adult
+//  EIchange, NAchange,.- Inputs of the adult model as in adult_weight_wrapper
+//  PAL, pcarb_base,      with a column for each time step from baseline (or a
+//  pcarb                 single row or column, see input_view.h)
+//  transition        .-  Age (yrs) at which children become adults
+//  knots             .-  Knots of the energy intake of the children (see Child::setKnots)
+//  solver            .-  List with the method ("RK4") and tables (see Child::setSolver)
+//                        and optionally the method of the adults as "adult"
+//  output            .-  Output options (see Lifecourse::rk4_fused)
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include <Rcpp.h>
+#include "lifecourse.h"
+#include "profile.h"
+
+// [[Rcpp::export]]
+List lifecourse_weight_wrapper(NumericVector age, NumericVector sex, NumericVector bmiCat,
+                               NumericVector FFM, NumericVector FM, NumericMatrix input_EIntake,
+                               NumericVector ht, NumericMatrix EIchange, NumericMatrix NAchange,
+                               NumericMatrix PAL, NumericVector pcarb_base, NumericVector pcarb,
+                               double transition, double days, double dt, bool checkValues,
+                               double referenceValues, int threads, List knots, List solver,
+                               List output){
+    
+    BW_PROFILE_START(threads, "build");
+    
+    //Create new children with characteristics
+    Child Person (age,  sex, bmiCat, FFM, FM, input_EIntake, dt, checkValues, referenceValues);
+    Person.setKnots(knots);
+    Person.setSolver(solver);
+    
+    //Run children and adults using the fused RK4
+    Lifecourse Life (Person, ht, EIchange, NAchange, PAL, pcarb_base, pcarb, transition, checkValues);
+    if (solver.containsElementNamed("adult")){
+        Life.setSolver(as<List>(solver["adult"]));
+    }
+    List results = Life.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
+    
+}
+
+// [[Rcpp::export]]
+List lifecourse_weight_wrapper_richardson(NumericVector age, NumericVector sex, NumericVector bmiCat,
+                                          NumericVector FFM, NumericVector FM, double K, double Q,
+                                          double A, double B, double nu, double C,
+                                          NumericVector ht, NumericMatrix EIchange,
+                                          NumericMatrix NAchange, NumericMatrix PAL,
+                                          NumericVector pcarb_base, NumericVector pcarb,
+                                          double transition, double days, double dt,
+                                          bool checkValues, double referenceValues, int threads,
+                                          List solver, List output){
+    
+    BW_PROFILE_START(threads, "build");
+    
+    //Create new children with characteristics
+    Child Person (age,  sex, bmiCat, FFM, FM, K, Q, A, B, nu, C, dt, checkValues, referenceValues);
+    Person.setSolver(solver);
+    
+    //Run children and adults using the fused RK4
+    Lifecourse Life (Person, ht, EIchange, NAchange, PAL, pcarb_base, pcarb, transition, checkValues);
+    if (solver.containsElementNamed("adult")){
+        Life.setSolver(as<List>(solver["adult"]));
+    }
+    List results = Life.rk4_fused(days, threads, output);
+    BW_PROFILE_ATTACH(results);
+    return results;
+    
+}
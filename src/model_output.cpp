@@ -0,0 +1,399 @@
+//
+//  model_output.cpp
+//
+//  This is a class that stores the output of the adult and children models
+//  while they are integrated. Instead of keeping every variable at every time
+//  step the caller chooses which variables to keep, how often they are reported
+//  (stride) and whether they are stored or summarised on the fly:
+//
+//  summary = "none"   .-  nind x nreport matrix for each variable
+//  summary = "final"  .-  vector with the final state of each variable
+//  summary = "mean"   .-  survey weighted mean (with its linearised standard
+//                         error) and variance of each variable by group at each
+//                         reported time (memory does not depend on nind)
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "model_output.h"
+
+//Set all accumulators to zero
+void ModelOutputPartial::reset(void){
+    std::fill(sums.begin(), sums.end(), 0.0);
+}
+
+//Estimates of a group (NA without weight and the variance NA for a single
+//individual)
+void ModelOutputPartial::estimate(const double *y, int nstrata, const double *stratum_n,
+                                  double *estimates){
+    
+    //Totals over strata
+    double x[nsums] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    for (int h = 0; h < nstrata; h++){
+        for (int q = 0; q < nsums; q++){
+            x[q] += y[h*nsums + q];
+        }
+    }
+    const double m = x[2]/x[1];
+    
+    //Linearised variance of the mean (individuals are the sampling units,
+    //z = w*(y - m)/W within the group)
+    double v = 0.0;
+    for (int h = 0; h < nstrata; h++){
+        const double *s  = y + h*nsums;
+        const double  nh = stratum_n[h];
+        if (nh > 1.0){
+            const double sz  = (s[2] - m*s[1])/x[1];
+            const double sz2 = (s[6] - 2.0*m*s[5] + m*m*s[4])/(x[1]*x[1]);
+            v += nh/(nh - 1.0)*(sz2 - sz*sz/nh);
+        }
+    }
+    
+    estimates[0] = x[0];
+    estimates[1] = x[1] > 0.0 ? m : NA_REAL;
+    estimates[2] = x[1] > 0.0 ? sqrt(std::max(v, 0.0)) : NA_REAL;
+    estimates[3] = x[0] > 1.0 ? std::max(x[0]/(x[0] - 1.0)*(x[3]/x[1] - m*m), 0.0) : NA_REAL;
+}
+
+//Constructor of the output
+ModelOutput::ModelOutput(std::vector<std::string> available, std::vector<std::string> vars,
+                         int stride, int nsims, int input_nind, std::string summary,
+                         IntegerVector group, NumericVector weights, IntegerVector strata,
+                         int nscenarios, List cells, std::string precision,
+                         std::vector<double> resolution, std::string path){
+    
+    names   = available;
+    nind    = input_nind;
+    nscen   = nscenarios;
+    nslots  = 0;
+    ngroups = 1;
+    nstrata = 1;
+    if (nscen < 1 || nind % nscen != 0){
+        stop("Invalid number of scenarios.");
+    }
+    nbase   = nind/nscen;
+    slot.assign(names.size(), -1);
+    exported.assign(names.size(), false);
+    store_precision  = precision;
+    store_resolution = resolution;
+    store_resolution.resize(names.size(), 1.0);
+    store_path       = path;
+    getPrecision(store_precision);  //Check the precision
+    
+    //Type of output
+    if (summary == "none"){
+        mode = NONE;
+    } else if (summary == "final"){
+        mode = FINAL;
+    } else if (summary == "mean"){
+        mode = MEAN;
+    } else {
+        stop("Invalid summary. Please specify either 'none', 'final' or 'mean'.");
+    }
+    
+    if (stride < 1){
+        stop("Invalid stride. Please specify a positive integer.");
+    }
+    
+    //Requested variables (all if none specified)
+    for (unsigned int i = 0; i < vars.size(); i++){
+        if (std::find(names.begin(), names.end(), vars[i]) == names.end()){
+            stop("Unknown variable '" + vars[i] + "' in vars.");
+        }
+    }
+    for (unsigned int k = 0; k < names.size(); k++){
+        exported[k] = std::find(vars.begin(), vars.end(), names[k]) != vars.end();
+    }
+    
+    //Reported steps: every stride steps and the last one ("final" only the last)
+    report.assign(nsims + 1, -1);
+    if (mode != FINAL){
+        for (int i = 0; i <= nsims; i += stride){
+            steps.push_back(i);
+        }
+    }
+    if (steps.empty() || steps.back() != nsims){
+        steps.push_back(nsims);
+    }
+    nreport = steps.size();
+    for (int r = 0; r < nreport; r++){
+        report[steps[r]] = r;
+    }
+    
+    //Position of each individual in the storage (its scenario after the reports)
+    if (mode != MEAN){
+        offset_ptr.resize(nind);
+        for (int j = 0; j < nind; j++){
+            offset_ptr[j] = (std::size_t) (j % nscen)*nreport*nbase + j/nscen;
+        }
+    }
+    
+    //Design for the reducers
+    if (mode == MEAN){
+        std::vector<int>    group_ptr(nbase, 0), strata_ptr(nbase, 0);
+        std::vector<double> base_weight(nbase, 1.0), base_n(nbase, 1.0);
+        if ((group.size() > 0 && group.size() != nbase) ||
+            (weights.size() > 0 && weights.size() != nbase) ||
+            (strata.size() > 0 && strata.size() != nbase)){
+            stop("Dimension mismatch. group, weights and strata must have the same length as individuals.");
+        }
+        for (int j = 0; j < group.size(); j++){
+            if (group[j] < 1){
+                stop("Invalid group. Groups must be coded as 1, 2, ..., ngroups.");
+            }
+            group_ptr[j] = group[j] - 1;
+            ngroups      = std::max(ngroups, group[j]);
+        }
+        for (int j = 0; j < strata.size(); j++){
+            if (strata[j] < 1){
+                stop("Invalid strata. Strata must be coded as 1, 2, ..., nstrata.");
+            }
+            strata_ptr[j] = strata[j] - 1;
+            nstrata       = std::max(nstrata, strata[j]);
+        }
+        for (int j = 0; j < weights.size(); j++){
+            if (weights[j] < 0.0){
+                stop("Invalid weights. Weights must not be negative.");
+            }
+            base_weight[j] = weights[j];
+        }
+        std::vector<double> base_weight2(nbase), base_positive(nbase);
+        for (int j = 0; j < nbase; j++){
+            base_weight2[j]  = base_weight[j]*base_weight[j];
+            base_positive[j] = base_weight[j] != 0.0;
+        }
+        
+        //Cells of identical individuals count as all of their individuals
+        if (cells.size() > 0){
+            NumericVector cell_n        = as<NumericVector>(cells["n"]);
+            NumericVector cell_positive = as<NumericVector>(cells["positive"]);
+            NumericVector cell_weights2 = as<NumericVector>(cells["weights2"]);
+            if (cell_n.size() != nbase || cell_positive.size() != nbase ||
+                cell_weights2.size() != nbase){
+                stop("Dimension mismatch. cells must have the same length as individuals.");
+            }
+            for (int j = 0; j < nbase; j++){
+                base_n[j]        = cell_n[j];
+                base_positive[j] = cell_positive[j];
+                base_weight2[j]  = cell_weights2[j];
+            }
+        }
+        
+        //Each scenario is a domain of its own with the strata of the individuals
+        ncells = nscen*ngroups*nstrata;
+        cell_ptr.resize(nind);
+        weight_ptr.resize(nind);
+        weight2_ptr.resize(nind);
+        count_ptr.resize(nind);
+        for (int j = 0; j < nind; j++){
+            const int b = j/nscen;
+            cell_ptr[j]    = ((j % nscen)*ngroups + group_ptr[b])*nstrata + strata_ptr[b];
+            weight_ptr[j]  = base_weight[b];
+            weight2_ptr[j] = base_weight2[b];
+            count_ptr[j]   = base_positive[b];
+        }
+        stratum_n.assign(nstrata, 0.0);
+        for (int j = 0; j < nbase; j++){
+            stratum_n[strata_ptr[j]] += base_n[j];
+        }
+    }
+    
+    //Storage for the requested variables
+    for (unsigned int k = 0; k < names.size(); k++){
+        if (exported[k]){
+            allocate(k, store_precision, store_resolution[k], true);
+        }
+    }
+    if (mode == MEAN){
+        total = partial();
+    }
+}
+
+//Assign a slot (and its values if they are stored) to variable var. Values
+//are written to the file of the variable in path if file.
+void ModelOutput::allocate(int var, std::string precision, double resolution, bool file){
+    slot[var] = nslots++;
+    if (mode != MEAN){
+        const std::string filename = (file && writes()) ? store_path + "/" + names[var] + ".bin" : "";
+        storage.push_back(OutputStore((std::size_t) nbase*nreport*nscen, precision, resolution,
+                                      filename));
+    }
+}
+
+//Store variable var even if the caller did not request it
+void ModelOutput::require(int var, std::string precision, double resolution, bool returned){
+    if (mode == MEAN){
+        stop("Cannot store values of variables with summary = 'mean'.");
+    }
+    if (slot[var] < 0){
+        allocate(var, precision, resolution, returned);
+    }
+    exported[var] = exported[var] || returned;
+}
+
+//Stored values of variable var
+const OutputStore &ModelOutput::values(int var) const {
+    if (slot[var] < 0 || mode == MEAN){
+        stop("Variable '" + names[var] + "' was not stored.");
+    }
+    return storage[slot[var]];
+}
+
+//Dimensions of the returned values of a variable
+IntegerVector ModelOutput::dims(void) const {
+    std::vector<int> d(1, nbase);
+    if (mode == NONE){
+        d.push_back(nreport);
+    }
+    if (nscen > 1){
+        d.push_back(nscen);
+    }
+    return IntegerVector(d.begin(), d.end());
+}
+
+//Correct_Values and Failed_Time of every individual
+void ModelOutput::validity(List &results, const std::vector<int> &failed, NumericVector TIME) const {
+    LogicalVector correct(nind); //in rcpp
+    NumericVector when(nind);    //in rcpp
+    for (int j = 0; j < nind; j++){
+        const int k = (j % nscen)*nbase + j/nscen;
+        correct[k]  = failed[j] < 0;
+        when[k]     = failed[j] < 0 ? NA_REAL : TIME[failed[j]];
+    }
+    if (nscen > 1){
+        correct.attr("dim") = IntegerVector::create(nbase, nscen);
+        when.attr("dim")    = IntegerVector::create(nbase, nscen);
+    }
+    results.push_back(correct, "Correct_Values");
+    results.push_back(when, "Failed_Time");
+}
+
+//Empty accumulators for a chunk of individuals
+ModelOutputPartial ModelOutput::partial(void) const {
+    ModelOutputPartial part;
+    if (mode == MEAN){
+        part.sums.assign(nreport*nslots*ncells*ModelOutputPartial::nsums, 0.0);
+    }
+    return part;
+}
+
+//Merge accumulators of a chunk. Chunks must be merged in the same order for
+//the result to not depend on the number of threads.
+void ModelOutput::merge(const ModelOutputPartial &part){
+    for (unsigned int k = 0; k < part.sums.size(); k++){
+        total.sums[k] += part.sums[k];
+    }
+}
+
+//List of results
+List ModelOutput::wrap(NumericVector TIME){
+    
+    NumericVector reported(nreport);
+    for (int r = 0; r < nreport; r++){
+        reported[r] = TIME[steps[r]];
+    }
+    
+    List out;
+    out.push_back(reported, "Time");
+    
+    if (mode == MEAN){
+        
+        //Data frame columns with one row per time, variable, scenario and group
+        const int size = nreport*nslots*nscen*ngroups;
+        NumericVector   time(size);
+        CharacterVector variable(size);
+        IntegerVector   scenarioid(size);
+        IntegerVector   groupid(size);
+        NumericVector   n(size);
+        NumericVector   mean(size);
+        NumericVector   se_mean(size);
+        NumericVector   variance(size);
+        for (unsigned int k = 0; k < names.size(); k++){
+            if (slot[k] >= 0){
+                for (int r = 0; r < nreport; r++){
+                    for (int c = 0; c < nscen; c++){
+                        for (int g = 0; g < ngroups; g++){
+                            double x[4];
+                            ModelOutputPartial::estimate(&total.sums[index(r, slot[k], c, g, 0)],
+                                                         nstrata, &stratum_n[0], x);
+                            const int i = ((r*nslots + slot[k])*nscen + c)*ngroups + g;
+                            time[i]       = reported[r];
+                            variable[i]   = names[k];
+                            scenarioid[i] = c + 1;
+                            groupid[i]    = g + 1;
+                            n[i]          = x[0];
+                            mean[i]       = x[1];
+                            se_mean[i]    = x[2];
+                            variance[i]   = x[3];
+                        }
+                    }
+                }
+            }
+        }
+        List summary = List::create(Named("time")     = time,
+                                    Named("variable") = variable,
+                                    Named("group")    = groupid,
+                                    Named("n")        = n,
+                                    Named("mean")     = mean,
+                                    Named("SE_mean")  = se_mean,
+                                    Named("variance") = variance);
+        if (nscen > 1){
+            summary.push_back(scenarioid, "scenario");
+        }
+        out.push_back(summary, "Summary");
+        
+    } else {
+        
+        for (unsigned int k = 0; k < names.size(); k++){
+            if (exported[k]){
+                out.push_back(storage[slot[k]].wrap(dims()), names[k]);
+            }
+        }
+        
+    }
+    
+    return out;
+}
+
+//Accumulators of every report, variable, scenario, group and stratum
+NumericVector ModelOutput::sums(void) const {
+    
+    NumericVector x(total.sums.size()); //in rcpp
+    std::copy(total.sums.begin(), total.sums.end(), x.begin());
+    std::vector<std::string> variables(nslots);
+    for (unsigned int k = 0; k < names.size(); k++){
+        if (slot[k] >= 0){
+            variables[slot[k]] = names[k];
+        }
+    }
+    if (nscen > 1){
+        x.attr("dim") = IntegerVector::create(ModelOutputPartial::nsums, nstrata, ngroups, nscen,
+                                              nslots, nreport);
+    } else {
+        x.attr("dim") = IntegerVector::create(ModelOutputPartial::nsums, nstrata, ngroups,
+                                              nslots, nreport);
+    }
+    x.attr("variables") = variables;
+    
+    return x;
+}
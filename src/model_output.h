@@ -0,0 +1,214 @@
+//
+//  model_output.h
+//
+//  This is a class that stores the output of the adult and children models
+//  while they are integrated. Instead of keeping every variable at every time
+//  step the caller chooses which variables to keep, how often they are reported
+//  (stride) and whether they are stored or summarised on the fly:
+//
+//  summary = "none"   .-  nind x nreport matrix for each variable
+//  summary = "final"  .-  vector with the final state of each variable
+//  summary = "mean"   .-  survey weighted mean (with its linearised standard
+//                         error) and variance of each variable by group at each
+//                         reported time (memory does not depend on nind)
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef model_output_h
+#define model_output_h
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <Rcpp.h>
+#include "output_store.h"
+using namespace Rcpp;
+
+//Accumulators of a chunk of individuals for summary = "mean". For each report,
+//variable, group and stratum they hold the sums of (w != 0), w, w*y, w*y^2,
+//w^2, w^2*y and w^2*y^2 where w is the weight of the individual.
+//--------------------------------------------------------------------------------
+class ModelOutputPartial {
+public:
+    static const int nsums = 7;
+    std::vector<double> sums;
+    void reset(void);
+    
+    //Estimates of a group from the sums of each of its nstrata strata (one after
+    //the other) with stratum_n individuals each: individuals with positive weight,
+    //mean, linearised standard error of the mean and variance
+    static void estimate(const double *sums, int nstrata, const double *stratum_n,
+                         double *estimates);
+};
+
+//Output of a model
+//--------------------------------------------------------------------------------
+class ModelOutput {
+public:
+    
+    //available: names of every variable the model computes (in output order)
+    //vars:      names of the variables to keep
+    //stride:    report every stride steps (the last step is always reported)
+    //summary:   "none", "final" or "mean"
+    //group:     group (1, ..., ngroups) of each individual for summary = "mean"
+    //weights:   survey weight of each individual for summary = "mean"
+    //strata:    stratum (1, ..., nstrata) of each individual for summary = "mean"
+    //(empty group, weights or strata give a single group, unit weights and a
+    //single stratum; each individual is its own sampling unit)
+    //nscenarios: scenarios of each individual. The model integrates nind =
+    //nbase x nscenarios individuals where j is scenario j % nscenarios of
+    //individual j / nscenarios (group, weights and strata are those of the nbase
+    //individuals). Values get one more dimension for the scenario and summaries
+    //are computed by scenario.
+    //cells:     for summary = "mean" when each individual is a cell of identical
+    //individuals (see cohort_cells.h); list with the individuals (n), those with
+    //positive weight (positive) and the sum of squared weights (weights2) of each
+    //cell, whose weights are the sums of their weights. Summaries are then the
+    //same as those of the individuals of the cells. Empty for one individual each.
+    //precision: storage of the values of summary "none" and "final" (see
+    //output_store.h) with the resolution of each available variable for the
+    //fixed point precisions (empty for 1)
+    //path:      directory where the values of summary "none" and "final" are
+    //written (file <variable>.bin of each one) instead of memory. Empty for memory.
+    ModelOutput(std::vector<std::string> available, std::vector<std::string> vars,
+                int stride, int nsims, int nind, std::string summary, IntegerVector group,
+                NumericVector weights, IntegerVector strata, int nscenarios = 1,
+                List cells = List(), std::string precision = "double",
+                std::vector<double> resolution = std::vector<double>(),
+                std::string path = "");
+    
+    int nreport;                //Number of reported times
+    std::vector<int> report;    //Report number of each step (-1 if not reported)
+    std::vector<int> steps;     //Step of each report
+    
+    //Whether variable var (index in available) has to be computed
+    bool wants(int var) const { return slot[var] >= 0; }
+    
+    //Whether variable var was requested by the caller
+    bool requested(int var) const { return exported[var]; }
+    
+    //Whether chunks have to be merged in order (summary = "mean")
+    bool reduces(void) const { return mode == MEAN; }
+    
+    //Store value of individual j for variable var at report r
+    void put(int var, int r, int j, double value, ModelOutputPartial &part){
+        const int s = slot[var];
+        if (s < 0){
+            return;
+        }
+        if (mode == MEAN){
+            const double w  = weight_ptr[j];
+            const double w2 = weight2_ptr[j];
+            double      *x  = &part.sums[((r*nslots + s)*ncells + cell_ptr[j])*ModelOutputPartial::nsums];
+            x[0] += count_ptr[j];
+            x[1] += w;
+            x[2] += w*value;
+            x[3] += w*value*value;
+            x[4] += w2;
+            x[5] += w2*value;
+            x[6] += w2*value*value;
+        } else {
+            storage[s].put((std::size_t) r*nbase + offset_ptr[j], value);
+        }
+    }
+    
+    //Also store variable var without returning it (for outputs derived from it)
+    //with its own precision and resolution. If returned, it is also returned
+    //(and written to path if there is one).
+    void require(int var, std::string precision = "double", double resolution = 1.0,
+                 bool returned = false);
+    
+    //Whether values are written to files
+    bool writes(void) const { return !store_path.empty(); }
+    
+    //Stored values of variable var (summary "none" or "final") in the order of
+    //an nbase x (nreport x nscenarios) matrix
+    const OutputStore &values(int var) const;
+    
+    //Dimensions of the returned values of a variable: nbase x nreport ("none")
+    //or nbase ("final") followed by the number of scenarios if there are several
+    IntegerVector dims(void) const;
+    
+    //x (with the values of a variable in the order of values) with the
+    //dimensions of dims
+    template <class T>
+    T shape(T x) const {
+        IntegerVector d = dims();
+        if (d.size() > 1){
+            x.attr("dim") = d;
+        }
+        return x;
+    }
+    
+    //Whether the state of each individual was valid at every step (Correct_Values)
+    //and the time of its first invalid step (Failed_Time, NA if none) given
+    //that step of TIME in failed (-1 if none), both nbase (x nscenarios)
+    void validity(List &results, const std::vector<int> &failed, NumericVector TIME) const;
+    
+    //Partial accumulators for a chunk and their merge (in chunk order)
+    ModelOutputPartial partial(void) const;
+    void merge(const ModelOutputPartial &part);
+    
+    //Return list with the reported times and the requested variables
+    List wrap(NumericVector TIME);
+    
+    //Merged accumulators of summary = "mean" as an nsums x nstrata x ngroups
+    //(x nscenarios) x variables x nreport array whose "variables" attribute has
+    //the names of its variables (to be added up over runs, see population.h)
+    NumericVector sums(void) const;
+    
+private:
+    
+    enum Mode {NONE, FINAL, MEAN};
+    Mode mode;
+    int  nind;
+    int  nbase;
+    int  nscen;
+    int  nslots;
+    int  ngroups;
+    int  nstrata;
+    int  ncells;     //nscen x ngroups x nstrata
+    std::vector<std::string>   names;     //Available variables
+    std::vector<int>           slot;      //Slot of each available variable (-1 if not stored)
+    std::vector<bool>          exported;  //Whether each available variable is returned
+    std::vector<OutputStore>   storage;   //nbase x nreport (x nscen) values of each slot
+    std::string                store_precision;
+    std::vector<double>        store_resolution;
+    std::string                store_path;
+    std::vector<std::size_t>   offset_ptr;//Position of each individual in report 0 of storage
+    std::vector<int>           cell_ptr;  //Scenario, group and stratum of each individual
+    std::vector<double>        weight_ptr;//Weight of each individual
+    std::vector<double>        weight2_ptr;//Squared weight of each individual
+    std::vector<double>        count_ptr; //Individuals with positive weight of each individual
+    std::vector<double>        stratum_n; //Individuals in each stratum
+    ModelOutputPartial         total;     //Merged accumulators
+    
+    void allocate(int var, std::string precision, double resolution, bool file);
+    int  index(int r, int s, int c, int g, int h) const {
+        return ((((r*nslots + s)*nscen + c)*ngroups + g)*nstrata + h)*ModelOutputPartial::nsums;
+    }
+};
+
+#endif /* model_output_h */
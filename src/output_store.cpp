@@ -0,0 +1,291 @@
+//
+//  output_store.cpp
+//
+//  This is a class that stores the values of an output variable of a model
+//  as double, float32 or fixed point int32 / int16 codes in memory or in a
+//  memory mapped file (see output_store.h).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "output_store.h"
+#include "profile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Bytes of each value of a precision
+static const std::size_t store_width[] = {8, 4, 4, 2};
+
+//Map file path (created with bytes bytes if write)
+MappedFile::MappedFile(std::string path, std::size_t input_bytes, bool write){
+    
+    data    = NULL;
+    bytes   = input_bytes;
+    fd      = -1;
+    file    = NULL;
+    mapping = NULL;
+    
+#ifdef _WIN32
+    HANDLE h = CreateFileA(path.c_str(), write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                           FILE_SHARE_READ, NULL, write ? CREATE_ALWAYS : OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE){
+        stop("Cannot open file '" + path + "'.");
+    }
+    LARGE_INTEGER length;
+    if (write){
+        length.QuadPart = bytes;
+    } else {
+        GetFileSizeEx(h, &length);
+        bytes = length.QuadPart;
+    }
+    if (bytes > 0){
+        HANDLE m = CreateFileMappingA(h, NULL, write ? PAGE_READWRITE : PAGE_READONLY,
+                                      length.HighPart, length.LowPart, NULL);
+        void  *p = m == NULL ? NULL : MapViewOfFile(m, write ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, bytes);
+        if (p == NULL){
+            if (m != NULL){
+                CloseHandle(m);
+            }
+            CloseHandle(h);
+            stop("Cannot map file '" + path + "' into memory.");
+        }
+        mapping = m;
+        data    = (unsigned char *) p;
+    }
+    file = h;
+#else
+    fd = open(path.c_str(), write ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (fd < 0){
+        stop("Cannot open file '" + path + "'.");
+    }
+    if (write && bytes > 0){
+        //Space is reserved beforehand so that a full disk is an error here
+        //instead of a crash when the values are written (an empty file is
+        //only created and truncated by open)
+#ifdef __linux__
+        const bool allocated = posix_fallocate(fd, 0, bytes) == 0;
+#else
+        const bool allocated = ftruncate(fd, bytes) == 0;
+#endif
+        if (!allocated){
+            close(fd);
+            stop("Cannot allocate " + std::to_string(bytes) + " bytes for file '" + path + "'.");
+        }
+    } else if (!write){
+        struct stat st;
+        fstat(fd, &st);
+        bytes = st.st_size;
+    }
+    if (bytes > 0){
+        void *p = mmap(NULL, bytes, write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED){
+            close(fd);
+            stop("Cannot map file '" + path + "' into memory.");
+        }
+        data = (unsigned char *) p;
+    }
+#endif
+}
+
+//Unmap (writing back the values) and close the file
+MappedFile::~MappedFile(void){
+#ifdef _WIN32
+    if (data != NULL){
+        UnmapViewOfFile(data);
+        CloseHandle((HANDLE) mapping);
+    }
+    CloseHandle((HANDLE) file);
+#else
+    if (data != NULL){
+        munmap(data, bytes);
+    }
+    close(fd);
+#endif
+}
+
+//Precision from its name
+StorePrecision getPrecision(std::string precision){
+    if (precision == "double"){
+        return STORE_DOUBLE;
+    } else if (precision == "float"){
+        return STORE_FLOAT;
+    } else if (precision == "int32"){
+        return STORE_INT32;
+    } else if (precision == "int16"){
+        return STORE_INT16;
+    }
+    stop("Invalid precision. Please specify either 'double', 'float', 'int32' or 'int16'.");
+    return STORE_DOUBLE;
+}
+
+//Resolution of each variable
+std::vector<double> getResolution(List resolution, std::vector<std::string> names){
+    std::vector<double> unit(names.size(), 1.0);
+    for (unsigned int k = 0; k < names.size(); k++){
+        if (resolution.containsElementNamed(names[k].c_str())){
+            unit[k] = as<double>(resolution[names[k]]);
+        }
+    }
+    return unit;
+}
+
+//Empty store
+OutputStore::OutputStore(void){
+    size       = 0;
+    precision  = STORE_DOUBLE;
+    resolution = 1.0;
+    path       = "";
+    dptr       = NULL;
+    iptr       = NULL;
+    bytes      = NULL;
+}
+
+//Store of size values
+OutputStore::OutputStore(std::size_t input_size, std::string input_precision,
+                         double input_resolution, std::string input_path){
+    
+    size       = input_size;
+    precision  = getPrecision(input_precision);
+    resolution = input_resolution;
+    path       = input_path;
+    dptr       = NULL;
+    iptr       = NULL;
+    bytes      = NULL;
+    if (!(resolution > 0.0)){
+        stop("Invalid resolution. Please specify positive values.");
+    }
+    
+    //Values in a file are written where the file is mapped
+    if (!path.empty()){
+        file  = std::make_shared<MappedFile>(path, size*store_width[precision], true);
+        dptr  = (double *) file->data;
+        iptr  = (int *) file->data;
+        bytes = file->data;
+        return;
+    }
+    
+    switch (precision){
+        case STORE_DOUBLE:
+            dvalues = NumericVector(size);
+            dptr    = dvalues.begin();
+            break;
+        case STORE_FLOAT:
+            rvalues = RawVector(4*size);
+            bytes   = rvalues.begin();
+            break;
+        case STORE_INT32:
+            ivalues = IntegerVector(size);
+            iptr    = ivalues.begin();
+            break;
+        case STORE_INT16:
+            rvalues = RawVector(2*size);
+            bytes   = rvalues.begin();
+            break;
+    }
+    BW_PROFILE_BYTES((double) size*store_width[precision]);
+}
+
+//Values for R
+SEXP OutputStore::wrap(IntegerVector dims) const {
+    
+    const char *names[] = {"double", "float", "int32", "int16"};
+    if (!path.empty()){
+        List x;
+        x.push_back(path, "path");
+        x.push_back(dims, "dim");
+        x.push_back(names[precision], "precision");
+        x.push_back(resolution, "resolution");
+        x.attr("class") = CharacterVector::create("bw_file", "bw_compact");
+        return x;
+    }
+    
+    if (precision == STORE_DOUBLE){
+        NumericVector x = dvalues;
+        if (dims.size() > 1){
+            x.attr("dim") = dims;
+        }
+        return x;
+    }
+    
+    List x;
+    if (precision == STORE_INT32){
+        x.push_back(ivalues, "values");
+    } else {
+        x.push_back(rvalues, "values");
+    }
+    x.push_back(dims, "dim");
+    x.push_back(names[precision], "precision");
+    x.push_back(resolution, "resolution");
+    x.attr("class") = "bw_compact";
+    return x;
+}
+
+//Decode the values at positions index of a bw_compact list
+NumericVector OutputStore::decode(List compact, NumericVector index){
+    
+    StorePrecision precision  = getPrecision(as<std::string>(compact["precision"]));
+    double         resolution = as<double>(compact["resolution"]);
+    const double        *dptr  = NULL;
+    const int           *iptr  = NULL;
+    const unsigned char *bytes = NULL;
+    std::size_t          size  = 0;
+    IntegerVector ivalues;
+    RawVector     rvalues;
+    std::shared_ptr<MappedFile> file;
+    if (compact.containsElementNamed("path")){
+        file  = std::make_shared<MappedFile>(as<std::string>(compact["path"]), 0, false);
+        dptr  = (const double *) file->data;
+        iptr  = (const int *) file->data;
+        bytes = file->data;
+        size  = file->bytes/store_width[precision];
+    } else if (precision == STORE_INT32){
+        ivalues = as<IntegerVector>(compact["values"]);
+        iptr    = ivalues.begin();
+        size    = ivalues.size();
+    } else if (precision != STORE_DOUBLE){
+        rvalues = as<RawVector>(compact["values"]);
+        bytes   = rvalues.begin();
+        size    = rvalues.size()/(precision == STORE_FLOAT ? 4 : 2);
+    } else {
+        stop("Values with precision 'double' are not compact.");
+    }
+    
+    NumericVector x(index.size());
+    for (int i = 0; i < index.size(); i++){
+        if (ISNAN(index[i]) || index[i] < 1 || index[i] > size){
+            x[i] = NA_REAL;
+        } else {
+            x[i] = decode(precision, resolution, dptr, iptr, bytes, (std::size_t) index[i] - 1);
+        }
+    }
+    
+    return x;
+}
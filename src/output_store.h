@@ -0,0 +1,167 @@
+//
+//  output_store.h
+//
+//  This is a class that stores the values of an output variable of a model
+//  (a trajectory or final values) as double, as single precision (float32) or
+//  as fixed point integers (int32 or int16 codes of value/resolution). Models
+//  integrate in double and only the stored values lose precision, which takes
+//  1/2 (float32, int32) or 1/4 (int16) of the memory of doubles. Values can
+//  also be written to a memory mapped file (one column major file per variable
+//  so that each reported time is a contiguous block) instead of R's memory.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef output_store_h
+#define output_store_h
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+enum StorePrecision {STORE_DOUBLE, STORE_FLOAT, STORE_INT32, STORE_INT16};
+
+//Precision from its name ("double", "float", "int32" or "int16")
+StorePrecision getPrecision(std::string precision);
+
+//Resolution of each of the variables names from a named list (1 if not in it)
+std::vector<double> getResolution(List resolution, std::vector<std::string> names);
+
+//File mapped into memory (created with bytes bytes if write, otherwise the
+//whole file is mapped read only). The file is unmapped and closed on destruction.
+//--------------------------------------------------------------------------------
+class MappedFile {
+public:
+    MappedFile(std::string path, std::size_t bytes, bool write);
+    ~MappedFile(void);
+    unsigned char *data;
+    std::size_t    bytes;
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+    int   fd;       //POSIX file descriptor
+    void *file;     //Windows handles
+    void *mapping;
+};
+
+//Values of a variable
+//--------------------------------------------------------------------------------
+class OutputStore {
+public:
+    
+    //size:       number of values
+    //precision:  "double", "float", "int32" or "int16"
+    //resolution: value of one unit of the fixed point codes (int32 and int16).
+    //Values that are NaN or outside the range of the codes are stored as NA.
+    //path:       file where the values are written (empty to keep them in memory)
+    OutputStore(void);
+    OutputStore(std::size_t size, std::string precision, double resolution = 1.0,
+                std::string path = "");
+    
+    std::size_t size;
+    
+    //Store value at position k (different positions may be written by
+    //different threads)
+    void put(std::size_t k, double value){
+        switch (precision){
+            case STORE_DOUBLE:
+                dptr[k] = value;
+                break;
+            case STORE_FLOAT: {
+                const float x = (float) value;
+                std::memcpy(bytes + 4*k, &x, 4);
+                break;
+            }
+            case STORE_INT32:
+                iptr[k] = code(value, 2147483647.0, NA_INTEGER);
+                break;
+            case STORE_INT16: {
+                const int16_t x = (int16_t) code(value, 32767.0, -32768);
+                std::memcpy(bytes + 2*k, &x, 2);
+                break;
+            }
+        }
+    }
+    
+    //Value at position k
+    double get(std::size_t k) const {
+        return decode(precision, resolution, dptr, iptr, bytes, k);
+    }
+    
+    //Values with dimensions dims: a numeric vector (or array) for "double" and
+    //otherwise a list of class bw_compact with the stored values (raw bytes
+    //for "float" and "int16"), their dim, precision and resolution. Values in a
+    //file give a list of class bw_file (and bw_compact) with its path instead.
+    SEXP wrap(IntegerVector dims) const;
+    
+    //Values at the (1-based, column major) positions index of a bw_compact list
+    //(only the pages of a file with the values are read)
+    static NumericVector decode(List compact, NumericVector index);
+    
+private:
+    
+    StorePrecision precision;
+    double         resolution;
+    NumericVector  dvalues;   //"double"
+    IntegerVector  ivalues;   //"int32"
+    RawVector      rvalues;   //"float" and "int16" (native byte order)
+    std::string    path;
+    std::shared_ptr<MappedFile> file; //Shared by the copies of the store
+    double        *dptr;
+    int           *iptr;
+    unsigned char *bytes;
+    
+    int code(double value, double max, int na) const {
+        const double x = std::floor(value/resolution + 0.5);
+        return std::fabs(x) <= max ? (int) x : na;
+    }
+    
+    static double decode(StorePrecision precision, double resolution, const double *dptr,
+                         const int *iptr, const unsigned char *bytes, std::size_t k){
+        switch (precision){
+            case STORE_DOUBLE:
+                return dptr[k];
+            case STORE_FLOAT: {
+                float x;
+                std::memcpy(&x, bytes + 4*k, 4);
+                return x;
+            }
+            case STORE_INT32:
+                return iptr[k] == NA_INTEGER ? NA_REAL : iptr[k]*resolution;
+            case STORE_INT16: {
+                int16_t x;
+                std::memcpy(&x, bytes + 2*k, 2);
+                return x == -32768 ? NA_REAL : x*resolution;
+            }
+        }
+        return NA_REAL;
+    }
+};
+
+#endif /* output_store_h */
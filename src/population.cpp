@@ -0,0 +1,125 @@
+//
+//  population.cpp
+//
+//  This is a class that adds up the survey weighted sums of the variables of a
+//  model by group and stratum of the chunks of a population that is integrated
+//  by chunks of individuals (see population_weight). The sums of every chunk
+//  are added up in R and the summary of the population is that of
+//  summary = "mean" (see model_output.h) without all of its individuals being
+//  in memory at once.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "population.h"
+
+//Constructor of the groups and strata of a chunk
+PopulationSums::PopulationSums(IntegerVector group, IntegerVector strata, NumericVector weights,
+                               int input_ngroups, int input_nstrata){
+    
+    nind    = group.size();
+    ngroups = input_ngroups;
+    nstrata = input_nstrata;
+    if (strata.size() != nind || weights.size() != nind){
+        stop("Dimension mismatch. group, strata and weights must have the same length.");
+    }
+    
+    cell_ptr.assign(nind, 0);
+    weight_ptr.assign(nind, 0.0);
+    for (int j = 0; j < nind; j++){
+        if (group[j] < 1 || group[j] > ngroups || strata[j] < 1 || strata[j] > nstrata){
+            stop("Invalid group or strata. They must be coded as 1, 2, ..., ngroups (nstrata).");
+        }
+        if (weights[j] < 0.0){
+            stop("Invalid weights. Weights must not be negative.");
+        }
+        cell_ptr[j]   = (group[j] - 1)*nstrata + strata[j] - 1;
+        weight_ptr[j] = weights[j];
+    }
+}
+
+//Sums of column y by group and stratum (in the order of the individuals so
+//they do not depend on the number of threads)
+void PopulationSums::add(const double *y, double *sums) const {
+    for (int j = 0; j < nind; j++){
+        const double w  = weight_ptr[j];
+        const double w2 = w*w;
+        double      *x  = sums + cell_ptr[j]*ModelOutputPartial::nsums;
+        x[0] += w != 0.0;
+        x[1] += w;
+        x[2] += w*y[j];
+        x[3] += w*y[j]*y[j];
+        x[4] += w2;
+        x[5] += w2*y[j];
+        x[6] += w2*y[j]*y[j];
+    }
+}
+
+//Summary of the population by report, variable and group
+List PopulationSums::summary(NumericVector sums, NumericVector stratum_n,
+                             std::vector<std::string> vars, NumericVector reported){
+    
+    const int nsums   = ModelOutputPartial::nsums;
+    const int nstrata = stratum_n.size();
+    const int nvars   = vars.size();
+    const int nreport = reported.size();
+    const std::size_t column = (std::size_t) nsums*nstrata;
+    if (nstrata == 0 || nvars == 0 || nreport == 0 || sums.size() == 0 ||
+        (std::size_t) sums.size() % (column*nvars*nreport) != 0){
+        stop("Dimension mismatch. sums must have the sums of every stratum, group, variable and report.");
+    }
+    const int ngroups = sums.size()/(column*nvars*nreport);
+    
+    //Data frame columns with one row per time, variable and group
+    const int size = nreport*nvars*ngroups;
+    NumericVector   time(size);
+    CharacterVector variable(size);
+    IntegerVector   groupid(size);
+    NumericVector   n(size);
+    NumericVector   mean(size);
+    NumericVector   se_mean(size);
+    NumericVector   variance(size);
+    for (int k = 0; k < nreport*nvars; k++){
+        for (int g = 0; g < ngroups; g++){
+            double x[4];
+            ModelOutputPartial::estimate(sums.begin() + ((std::size_t) k*ngroups + g)*column,
+                                         nstrata, stratum_n.begin(), x);
+            const int i = k*ngroups + g;
+            time[i]     = reported[k/nvars];
+            variable[i] = vars[k % nvars];
+            groupid[i]  = g + 1;
+            n[i]        = x[0];
+            mean[i]     = x[1];
+            se_mean[i]  = x[2];
+            variance[i] = x[3];
+        }
+    }
+    
+    return List::create(Named("time")     = time,
+                        Named("variable") = variable,
+                        Named("group")    = groupid,
+                        Named("n")        = n,
+                        Named("mean")     = mean,
+                        Named("SE_mean")  = se_mean,
+                        Named("variance") = variance);
+}
@@ -0,0 +1,80 @@
+//
+//  population.h
+//
+//  This is a class that adds up the survey weighted sums of the variables of a
+//  model by group and stratum of the chunks of a population that is integrated
+//  by chunks of individuals (see population_weight). The sums are those of
+//  ModelOutput::sums (that the adults return themselves); the sums of every
+//  chunk are added up in R and the summary of the population is that of
+//  summary = "mean" (see model_output.h) without all of its individuals being
+//  in memory at once.
+//
+//  INPUT:
+//  group   .- Group (1, ..., ngroups) of each individual of the chunk.
+//  strata  .- Stratum (1, ..., nstrata) of each individual of the chunk.
+//  weights .- Survey weight of each individual of the chunk.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef population_h
+#define population_h
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <Rcpp.h>
+#include "model_output.h"
+using namespace Rcpp;
+
+class PopulationSums {
+public:
+    
+    //group:   group (1, ..., ngroups) of each individual of the chunk
+    //strata:  stratum (1, ..., nstrata) of each individual of the chunk
+    //weights: survey weight of each individual of the chunk
+    PopulationSums(IntegerVector group, IntegerVector strata, NumericVector weights,
+                   int ngroups, int nstrata);
+    
+    int nind;
+    int ngroups;
+    int nstrata;
+    
+    //Adds the sums of column y (nind values) of each group and stratum to sums
+    //(nsums x nstrata x ngroups) as those of ModelOutputPartial: (w != 0), w,
+    //w*y, w*y^2, w^2, w^2*y and w^2*y^2
+    void add(const double *y, double *sums) const;
+    
+    //Summary (as the one of ModelOutput::wrap) of the ncolumns = nvars x nreport
+    //columns (the variables of each report) of sums (nsums x nstrata x ngroups x
+    //ncolumns) given the individuals of each stratum (stratum_n)
+    static List summary(NumericVector sums, NumericVector stratum_n,
+                        std::vector<std::string> vars, NumericVector time);
+    
+private:
+    
+    std::vector<int>    cell_ptr;   //Stratum and group (0-based) of each individual
+    std::vector<double> weight_ptr; //Weight of each individual
+};
+
+#endif /* population_h */
@@ -0,0 +1,115 @@
+//
+//  population_wrapper.cpp
+//
+//  These are functions that use Rcpp to add up the survey weighted sums of the
+//  results of a chunk of a population and to summarise the sums of the whole
+//  population (see population.h).
+//
+//  Input (population_sums_wrapper):
+//  model           .-  List from the model run with the individuals of the chunk.
+//  vars            .-  Variables of model (nind x nreport matrices or nind vectors).
+//  group           .-  Group (1, ..., ngroups) of each individual of the chunk.
+//  strata          .-  Stratum (1, ..., nstrata) of each individual of the chunk.
+//  weights         .-  Survey weight of each individual of the chunk.
+//  ngroups         .-  Groups of the chunk.
+//  nstrata         .-  Strata of the chunk.
+//  threads         .-  Number of threads.
+//
+//  Output:
+//  Array nsums x nstrata x ngroups x nvars x nreport with the sums of the
+//  variables of each report (see PopulationSums::add and ModelOutput::sums).
+//
+//  Input (population_summary_wrapper):
+//  sums            .-  Sums of the population (added up over its chunks).
+//  stratum_n       .-  Individuals of each stratum of the population.
+//  vars, time      .-  Variables and reported times of sums.
+//
+//  Output:
+//  List with the columns of the summary (as with summary = "mean").
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include <Rcpp.h>
+#include "population.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// [[Rcpp::export]]
+NumericVector population_sums_wrapper(List model, std::vector<std::string> vars,
+                                      IntegerVector group, IntegerVector strata,
+                                      NumericVector weights, int ngroups, int nstrata,
+                                      int threads){
+    
+    //Groups and strata of the chunk
+    PopulationSums population(group, strata, weights, ngroups, nstrata);
+    const int ncells = ngroups*nstrata;
+    const int nind  = population.nind;
+    const int nvars = vars.size();
+    const int nsums = ModelOutputPartial::nsums;
+    if (nvars == 0){
+        stop("Invalid vars. Please specify the variables to add up.");
+    }
+    
+    //Columns of each report and variable (as plain pointers for the workers)
+    std::vector<NumericVector> values;
+    int nreport = -1;
+    for (int v = 0; v < nvars; v++){
+        values.push_back(as<NumericVector>(model[vars[v]]));
+        if (nind == 0 || values[v].size() % nind != 0 ||
+            (nreport >= 0 && values[v].size()/nind != nreport)){
+            stop("Dimension mismatch. " + vars[v] + " must have a column per report " +
+                 "and a row per individual.");
+        }
+        nreport = values[v].size()/nind;
+    }
+    const int ncolumns = nreport*nvars;
+    std::vector<const double*> columns(ncolumns);
+    for (int r = 0; r < nreport; r++){
+        for (int v = 0; v < nvars; v++){
+            columns[r*nvars + v] = values[v].begin() + (std::size_t) r*nind;
+        }
+    }
+    
+    NumericVector sums((std::size_t) nsums*ncells*ncolumns); //in rcpp
+    double *sums_ptr = sums.begin();
+    
+    //Each column is added up independently so sums do not depend on threads
+#ifdef _OPENMP
+    #pragma omp parallel for num_threads(std::max(threads, 1)) schedule(dynamic, 1)
+#endif
+    for (int k = 0; k < ncolumns; k++){
+        population.add(columns[k], sums_ptr + (std::size_t) k*ncells*nsums);
+    }
+    
+    sums.attr("dim") = IntegerVector::create(nsums, nstrata, ngroups, nvars, nreport);
+    return sums;
+    
+}
+
+// [[Rcpp::export]]
+List population_summary_wrapper(NumericVector sums, NumericVector stratum_n,
+                                std::vector<std::string> vars, NumericVector time){
+    return PopulationSums::summary(sums, stratum_n, vars, time);
+}
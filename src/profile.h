@@ -0,0 +1,176 @@
+//
+//  profile.h
+//
+//  Optional instrumentation of the engines. When the package is compiled with
+//  BW_PROFILE defined (PKG_CPPFLAGS = -DBW_PROFILE in Makevars) the wrappers
+//  time each phase of a run (building the individuals, setting up the output,
+//  integrating, labelling BMI_Category and building the returned List), count
+//  the evaluations of the right-hand sides of the ODEs and the bytes of the
+//  outputs allocated, and time the chunks integrated by each thread. They are
+//  returned in the "profile" attribute of the result (see model_profile).
+//  Without BW_PROFILE every macro is empty so the engines are unchanged.
+//
+//  Phases are laps: BW_PROFILE_PHASE(name) ends the current phase and starts
+//  name (time of repeated phases is added up) so it does not need a scope.
+//  Counters of each thread are kept apart (one cache line each) and are only
+//  added up by BW_PROFILE_ATTACH once the parallel regions are over.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#ifndef profile_h
+#define profile_h
+
+#ifdef BW_PROFILE
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//Counters of a thread (padded to its own cache line)
+struct ProfileThread {
+    double seconds;   //Time spent integrating chunks
+    double chunks;    //Chunks integrated
+    double rhs;       //Evaluations of the right-hand sides
+    double pad[5];
+};
+
+class Profile {
+public:
+    
+    //Wall time (s)
+    static double now(void){
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    //New run with (up to) threads workers whose first phase is name
+    static void start(int threads, const char *name){
+        Profile &p = get();
+        p.names.clear();
+        p.seconds.clear();
+        p.bytes   = 0.0;
+        p.current = -1;
+        p.slots.assign(std::max(threads, 1), ProfileThread());
+        phase(name);
+    }
+    
+    //End the current phase and start name
+    static void phase(const char *name){
+        Profile &p = get();
+        const double t = now();
+        if (p.current >= 0){
+            p.seconds[p.current] += t - p.t0;
+        }
+        p.current = std::find(p.names.begin(), p.names.end(), name) - p.names.begin();
+        if (p.current == (int) p.names.size()){
+            p.names.push_back(name);
+            p.seconds.push_back(0.0);
+        }
+        p.t0 = t;
+    }
+    
+    //Counters of the calling thread
+    static ProfileThread &thread(void){
+        Profile &p = get();
+#ifdef _OPENMP
+        return p.slots[std::min((int) p.slots.size() - 1, omp_get_thread_num())];
+#else
+        return p.slots[0];
+#endif
+    }
+    
+    static void allocated(double n){
+        get().bytes += n;
+    }
+    
+    //Counters of the run (ends the current phase)
+    static Rcpp::List list(void){
+        Profile &p = get();
+        phase("wrap");
+        p.current = -1;
+        const int nthreads = p.slots.size();
+        Rcpp::NumericVector phases(p.seconds.begin(), p.seconds.end());
+        Rcpp::NumericVector seconds(nthreads), chunks(nthreads), rhs(nthreads);
+        phases.attr("names") = p.names;
+        for (int k = 0; k < nthreads; k++){
+            seconds[k] = p.slots[k].seconds;
+            chunks[k]  = p.slots[k].chunks;
+            rhs[k]     = p.slots[k].rhs;
+        }
+        return Rcpp::List::create(Rcpp::Named("phases")  = phases,
+                                  Rcpp::Named("rhs")     = Rcpp::sum(rhs),
+                                  Rcpp::Named("bytes")   = p.bytes,
+                                  Rcpp::Named("threads") = Rcpp::List::create(Rcpp::Named("seconds") = seconds,
+                                                                              Rcpp::Named("chunks")  = chunks,
+                                                                              Rcpp::Named("rhs")     = rhs));
+    }
+    
+private:
+    std::vector<std::string>   names;
+    std::vector<double>        seconds;
+    std::vector<ProfileThread> slots;
+    double                     bytes;
+    double                     t0;
+    int                        current;
+    
+    static Profile &get(void){
+        static Profile p;
+        return p;
+    }
+};
+
+//Time of a chunk added to the thread that integrates it
+struct ProfileChunk {
+    double t0;
+    ProfileChunk(void) : t0(Profile::now()) {}
+    ~ProfileChunk(void){
+        ProfileThread &c = Profile::thread();
+        c.seconds += Profile::now() - t0;
+        c.chunks  += 1.0;
+    }
+};
+
+#define BW_PROFILE_START(threads, name) Profile::start(threads, name)
+#define BW_PROFILE_PHASE(name)          Profile::phase(name)
+#define BW_PROFILE_CHUNK()              ProfileChunk bw_profile_chunk
+#define BW_PROFILE_RHS(n)               (Profile::thread().rhs += (n))
+#define BW_PROFILE_BYTES(n)             Profile::allocated(n)
+#define BW_PROFILE_ATTACH(x)            ((x).attr("profile") = Profile::list())
+
+#else
+
+#define BW_PROFILE_START(threads, name)
+#define BW_PROFILE_PHASE(name)
+#define BW_PROFILE_CHUNK()
+#define BW_PROFILE_RHS(n)
+#define BW_PROFILE_BYTES(n)
+#define BW_PROFILE_ATTACH(x)
+
+#endif
+
+#endif /* profile_h */
@@ -0,0 +1,157 @@
+//
+//  survey_mean.cpp
+//
+//  This is a class that estimates survey weighted means and variances by group
+//  of the model variables together with their linearised standard errors
+//  (as in svyby with svymean and svyvar from the survey package) for a design
+//  with weights, strata and primary sampling units (with replacement).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include "survey_mean.h"
+
+//Constructor of the design
+SurveyMean::SurveyMean(IntegerVector group, NumericVector weights, IntegerVector strata,
+                       IntegerVector psu){
+    
+    nind = group.size();
+    if (weights.size() != nind || strata.size() != nind || psu.size() != nind){
+        stop("Dimension mismatch. group, weights, strata and psu must have the same length.");
+    }
+    
+    ngroups = 1;
+    nstrata = 1;
+    npsu    = 1;
+    for (int j = 0; j < nind; j++){
+        if (group[j] < 1 || strata[j] < 1 || psu[j] < 1){
+            stop("Invalid design. group, strata and psu must be coded as 1, 2, ...");
+        }
+        ngroups = std::max(ngroups, group[j]);
+        nstrata = std::max(nstrata, strata[j]);
+        npsu    = std::max(npsu, psu[j]);
+    }
+    
+    group_ptr.assign(nind, 0);
+    psu_ptr.assign(nind, 0);
+    weight.assign(nind, 0.0);
+    psu_stratum.assign(npsu, -1);
+    psu_count.assign(nstrata, 0.0);
+    for (int j = 0; j < nind; j++){
+        group_ptr[j] = group[j] - 1;
+        psu_ptr[j]   = psu[j] - 1;
+        weight[j]    = weights[j];
+        if (psu_stratum[psu_ptr[j]] < 0){
+            psu_stratum[psu_ptr[j]] = strata[j] - 1;
+            psu_count[strata[j] - 1] += 1.0;
+        } else if (psu_stratum[psu_ptr[j]] != strata[j] - 1){
+            stop("Invalid design. Each psu must belong to a single stratum.");
+        }
+    }
+}
+
+//Work vector: PSU totals of the linearised variable of each group plus the
+//stratum sums and the weighted sums of each group
+int SurveyMean::workSize(void) const {
+    return ngroups*npsu + 2*nstrata + 3*ngroups;
+}
+
+//Variance of the total of z (PSU totals) under with-replacement sampling of
+//PSUs within strata. Strata with a single PSU do not contribute.
+double SurveyMean::linearised(const double *z, double *stratum_sum, double *stratum_sq) const {
+    
+    std::fill(stratum_sum, stratum_sum + nstrata, 0.0);
+    std::fill(stratum_sq, stratum_sq + nstrata, 0.0);
+    for (int c = 0; c < npsu; c++){
+        const int h = psu_stratum[c];
+        if (h >= 0){
+            stratum_sum[h] += z[c];
+            stratum_sq[h]  += z[c]*z[c];
+        }
+    }
+    
+    double v = 0.0;
+    for (int h = 0; h < nstrata; h++){
+        const double nh = psu_count[h];
+        if (nh > 1.0){
+            v += nh/(nh - 1.0)*(stratum_sq[h] - stratum_sum[h]*stratum_sum[h]/nh);
+        }
+    }
+    return std::max(v, 0.0);
+}
+
+//Mean, standard error of the mean, variance and standard error of the variance
+//of y by group in three passes over y. The variance is the svyvar estimate,
+//n/(n - 1) times the weighted mean of the squared deviations, where n is the
+//number of individuals with positive weight in the group.
+void SurveyMean::estimate(const double *y, double *mean, double *se_mean, double *variance,
+                          double *se_variance, std::vector<double> &work) const {
+    
+    double *z           = &work[0];
+    double *stratum_sum = z + ngroups*npsu;
+    double *stratum_sq  = stratum_sum + nstrata;
+    double *W           = stratum_sq + nstrata;
+    double *n           = W + ngroups;
+    double *WU          = n + ngroups;
+    std::fill(W, W + 3*ngroups, 0.0);
+    
+    //Weighted means
+    std::fill(mean, mean + ngroups, 0.0);
+    for (int j = 0; j < nind; j++){
+        const int g = group_ptr[j];
+        W[g]    += weight[j];
+        n[g]    += weight[j] != 0.0;
+        mean[g] += weight[j]*y[j];
+    }
+    for (int g = 0; g < ngroups; g++){
+        mean[g] = W[g] > 0.0 ? mean[g]/W[g] : NA_REAL;
+    }
+    
+    //Linearised mean and weighted squared deviations
+    std::fill(z, z + ngroups*npsu, 0.0);
+    for (int j = 0; j < nind; j++){
+        const int g = group_ptr[j];
+        if (W[g] > 0.0){
+            const double d = y[j] - mean[g];
+            z[g*npsu + psu_ptr[j]] += weight[j]*d/W[g];
+            WU[g] += weight[j]*d*d;
+        }
+    }
+    for (int g = 0; g < ngroups; g++){
+        se_mean[g]  = W[g] > 0.0 ? sqrt(linearised(z + g*npsu, stratum_sum, stratum_sq)) : NA_REAL;
+        variance[g] = n[g] > 1.0 ? n[g]/(n[g] - 1.0)*WU[g]/W[g] : NA_REAL;
+    }
+    
+    //Linearised variance
+    std::fill(z, z + ngroups*npsu, 0.0);
+    for (int j = 0; j < nind; j++){
+        const int g = group_ptr[j];
+        if (n[g] > 1.0){
+            const double d = y[j] - mean[g];
+            z[g*npsu + psu_ptr[j]] += weight[j]*(n[g]/(n[g] - 1.0)*d*d - variance[g])/W[g];
+        }
+    }
+    for (int g = 0; g < ngroups; g++){
+        se_variance[g] = n[g] > 1.0 ? sqrt(linearised(z + g*npsu, stratum_sum, stratum_sq)) : NA_REAL;
+    }
+}
@@ -0,0 +1,74 @@
+//
+//  survey_mean.h
+//
+//  This is a class that estimates survey weighted means and variances by group
+//  of the model variables together with their linearised standard errors
+//  (as in svyby with svymean and svyvar from the survey package) for a design
+//  with weights, strata and primary sampling units (with replacement).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef survey_mean_h
+#define survey_mean_h
+
+#include <vector>
+#include <Rcpp.h>
+using namespace Rcpp;
+
+class SurveyMean {
+public:
+    
+    //group:   group (1, ..., ngroups) of each individual
+    //weights: sampling weight of each individual
+    //strata:  stratum (1, ..., nstrata) of each individual
+    //psu:     primary sampling unit (1, ..., npsu) of each individual; each
+    //         sampling unit must belong to a single stratum
+    SurveyMean(IntegerVector group, NumericVector weights, IntegerVector strata,
+               IntegerVector psu);
+    
+    int ngroups;
+    
+    //Estimates of column y (nind values) for each group
+    void estimate(const double *y, double *mean, double *se_mean, double *variance,
+                  double *se_variance, std::vector<double> &work) const;
+    
+    //Size of the work vector needed by estimate
+    int workSize(void) const;
+    
+private:
+    
+    int nind;
+    int nstrata;
+    int npsu;
+    std::vector<int>    group_ptr;   //Group (0-based) of each individual
+    std::vector<int>    psu_ptr;     //PSU (0-based) of each individual
+    std::vector<int>    psu_stratum; //Stratum (0-based) of each PSU
+    std::vector<double> psu_count;   //Number of PSUs in each stratum
+    std::vector<double> weight;      //Weight of each individual
+    
+    double linearised(const double *z, double *stratum_sum, double *stratum_sq) const;
+};
+
+#endif /* survey_mean_h */
@@ -0,0 +1,124 @@
+//
+//  survey_mean_wrapper.cpp
+//
+//  This is a function that uses Rcpp to return the survey weighted mean
+//  and variance by group of the variables of a model (see survey_mean.h)
+//  for several days in one pass over the model matrices.
+//
+//  Input:
+//  model           .-  List from adult_weight or child_weight.
+//  vars            .-  Names of the variables (nind x ntimes matrices) to estimate.
+//  days            .-  Columns (starting in 1) of the matrices to estimate.
+//  group           .-  Group (1, ..., ngroups) of each individual.
+//  weights         .-  Sampling weight of each individual.
+//  strata          .-  Stratum (1, ..., nstrata) of each individual.
+//  psu             .-  Primary sampling unit (1, ..., npsu) of each individual.
+//  threads         .-  Number of threads used to estimate the columns.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+#include <Rcpp.h>
+#include "survey_mean.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// [[Rcpp::export]]
+List survey_mean_wrapper(List model, std::vector<std::string> vars, IntegerVector days,
+                         IntegerVector group, NumericVector weights, IntegerVector strata,
+                         IntegerVector psu, int threads){
+    
+    //Create design
+    SurveyMean design(group, weights, strata, psu);
+    
+    const int nvars   = vars.size();
+    const int ndays   = days.size();
+    const int ngroups = design.ngroups;
+    const int size    = ndays*nvars*ngroups;
+    
+    //Columns to estimate (as plain pointers for the workers)
+    NumericVector TIME = as<NumericVector>(model["Time"]);
+    std::vector<NumericMatrix> matrices;
+    std::vector<const double*> columns(ndays*nvars);
+    for (int v = 0; v < nvars; v++){
+        matrices.push_back(as<NumericMatrix>(model[vars[v]]));
+        if (matrices[v].nrow() != group.size()){
+            stop("Dimension mismatch. " + vars[v] + " must have one row per individual.");
+        }
+        for (int t = 0; t < ndays; t++){
+            if (days[t] < 1 || days[t] > matrices[v].ncol()){
+                stop("Invalid days. Some days are not available in model.");
+            }
+            columns[t*nvars + v] = matrices[v].begin() + (days[t] - 1)*matrices[v].nrow();
+        }
+    }
+    
+    //One row per day, variable and group (same order as model_mean)
+    NumericVector   time(size);
+    CharacterVector variable(size);
+    IntegerVector   groupid(size);
+    NumericVector   mean(size);
+    NumericVector   se_mean(size);
+    NumericVector   variance(size);
+    NumericVector   se_variance(size);
+    for (int t = 0; t < ndays; t++){
+        for (int v = 0; v < nvars; v++){
+            for (int g = 0; g < ngroups; g++){
+                const int i = (t*nvars + v)*ngroups + g;
+                time[i]     = TIME[days[t] - 1];
+                variable[i] = vars[v];
+                groupid[i]  = g + 1;
+            }
+        }
+    }
+    
+    double *mean_ptr        = mean.begin();
+    double *se_mean_ptr     = se_mean.begin();
+    double *variance_ptr    = variance.begin();
+    double *se_variance_ptr = se_variance.begin();
+    
+    //Each column is estimated independently so results do not depend on threads
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(std::max(threads, 1))
+#endif
+    {
+        std::vector<double> work(design.workSize());
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic, 1)
+#endif
+        for (int k = 0; k < ndays*nvars; k++){
+            design.estimate(columns[k], mean_ptr + k*ngroups, se_mean_ptr + k*ngroups,
+                            variance_ptr + k*ngroups, se_variance_ptr + k*ngroups, work);
+        }
+    }
+    
+    return List::create(Named("time")        = time,
+                        Named("variable")    = variable,
+                        Named("group")       = groupid,
+                        Named("mean")        = mean,
+                        Named("SE_mean")     = se_mean,
+                        Named("variance")    = variance,
+                        Named("SE_variance") = se_variance);
+    
+}
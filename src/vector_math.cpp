@@ -0,0 +1,185 @@
+//
+//  vector_math.cpp
+//
+//  Vectorised transcendental functions for the population loops of the fused
+//  engines. Each function evaluates a whole array (for instance one RK stage of
+//  every individual of a chunk) with explicit SIMD vectors: 4 doubles that are
+//  compiled to AVX2 (selected at run time on x86-64 CPUs that have it), to SSE2
+//  on older x86-64 CPUs and to NEON on arm64. Products and sums are never
+//  contracted to FMA (not even on arm64, where GCC does so by default), so every
+//  element is rounded in the same way on every CPU and the exponentials do not
+//  depend on the machine or on the position of an individual in the array.
+//
+//  vexp .- exp(x) within 1 ulp of the C library. Values above log(DBL_MAX) give
+//          Inf and those below -708 give 0 (exp(-708) is 3.3e-308).
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits>
+#include "vector_math.h"
+
+//Kernels are compiled without FMA contractions whatever -ffp-contract is (GCC
+//defaults to fast in the gnu++ modes R uses, which fuses the polynomials on arm64)
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+//AVX2 and baseline versions of the kernels chosen when the library is loaded
+//(ifunc). AVX-512 is left out as it brings FMA contractions that would give
+//different results on different machines.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__ELF__) && defined(__GLIBC__)
+#define VECTOR_MATH_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define VECTOR_MATH_CLONES
+#endif
+
+#if defined(__GNUC__)
+
+//Vectors of 4 doubles (and of their bits) of the GCC/clang vector extensions
+typedef double  vdouble __attribute__((vector_size(32)));
+typedef int64_t vint    __attribute__((vector_size(32)));
+static const int width = sizeof(vdouble)/sizeof(double);
+
+//y = a where m is set. The select is done on the bits because the ?: of vectors
+//is split into scalar branches when the comparison may trap.
+static inline void blend(vdouble &y, const vint &m, const vdouble &a){
+    vint iy, ia;
+    memcpy(&iy, &y, sizeof y);
+    memcpy(&ia, &a, sizeof a);
+    iy = (ia & m) | (iy & ~m);
+    memcpy(&y, &iy, sizeof y);
+}
+
+//exp of width elements: x = k ln2 + r with |r| <= ln2/2 (Cody and Waite), exp(r)
+//by the rational approximation of fdlibm and 2^k built from its bits
+static inline void expBlock(const double *px, double *py){
+    const double ln2hi = 6.93147180369123816490e-01;
+    const double ln2lo = 1.90821492927058770002e-10;
+    const double log2e = 1.44269504088896338700e+00;
+    const double shift = 6755399441055744.0;       //1.5*2^52 rounds to integers
+    const int64_t shift_bits = 0x4338000000000000LL;
+    const vdouble xmax = vdouble{} + 709.79;
+    const vdouble xmin = vdouble{} - 708.0;
+    
+    vdouble x;
+    memcpy(&x, px, sizeof x);
+    vdouble v = x;
+    blend(v, (vint) (x > xmax), xmax);
+    blend(v, (vint) (x < xmin), xmin);
+    
+    //k = round(v/ln2) (its bits are those of kd)
+    vdouble kd = v*log2e + shift;
+    vint    kb;
+    memcpy(&kb, &kd, sizeof kd);
+    kd = kd - shift;
+    
+    const vdouble hi = v - kd*ln2hi;
+    const vdouble lo = kd*ln2lo;
+    const vdouble r  = hi - lo;
+    const vdouble t  = r*r;
+    const vdouble c  = r - t*(1.66666666666666019037e-01 + t*(-2.77777777770155933842e-03 +
+                           t*(6.61375632143793436117e-05 + t*(-1.65339022054652515390e-06 +
+                           t*4.13813679705723846039e-08))));
+    const vdouble e  = 1.0 - ((lo - (r*c)/(2.0 - c)) - hi);
+    
+    //2^(k - 1) (k is at most 1024) is exact so y = 2 e 2^(k - 1) = e 2^k
+    vint    sb = (kb - shift_bits + 1022) << 52;
+    vdouble s;
+    memcpy(&s, &sb, sizeof s);
+    vdouble y = (2.0*e)*s;
+    
+    blend(y, (vint) (x > xmax), vdouble{} + std::numeric_limits<double>::infinity());
+    blend(y, (vint) (x < xmin), vdouble{});
+    memcpy(py, &y, sizeof y);
+}
+
+VECTOR_MATH_CLONES
+void vexp(const double *x, double *y, int n){
+    int i = 0;
+    for (; i + width <= n; i += width){
+        expBlock(x + i, y + i);
+    }
+    
+    //The last elements go through the same kernel
+    if (i < n){
+        double xb[width] = {0.0}, yb[width];
+        memcpy(xb, x + i, (n - i)*sizeof(double));
+        expBlock(xb, yb);
+        memcpy(y + i, yb, (n - i)*sizeof(double));
+    }
+}
+
+VECTOR_MATH_CLONES
+bool vflag(const double *x, double lower, unsigned char *bad, int n){
+    const vdouble lo  = vdouble{} + lower;
+    const vdouble inf = vdouble{} + std::numeric_limits<double>::infinity();
+    bool any = false;
+    int  i   = 0;
+    for (; i + width <= n; i += width){
+        vdouble v;
+        memcpy(&v, x + i, sizeof v);
+        const vint m = ~((vint) (v > lo) & (vint) (v < inf));
+        if (m[0] | m[1] | m[2] | m[3]){
+            for (int l = 0; l < width; l++){
+                bad[i + l] |= m[l] != 0;
+            }
+            any = true;
+        }
+    }
+    for (; i < n; i++){
+        if (!(x[i] > lower && x[i] < std::numeric_limits<double>::infinity())){
+            bad[i] = 1;
+            any    = true;
+        }
+    }
+    return any;
+}
+
+#else
+
+//Compilers without vector extensions use the C library
+void vexp(const double *x, double *y, int n){
+    for (int i = 0; i < n; i++){
+        y[i] = exp(x[i]);
+    }
+}
+
+bool vflag(const double *x, double lower, unsigned char *bad, int n){
+    bool any = false;
+    for (int i = 0; i < n; i++){
+        if (!(x[i] > lower && x[i] < std::numeric_limits<double>::infinity())){
+            bad[i] = 1;
+            any    = true;
+        }
+    }
+    return any;
+}
+
+#endif
@@ -0,0 +1,54 @@
+//
+//  vector_math.h
+//
+//  Vectorised transcendental functions for the population loops of the fused
+//  engines. Each function evaluates a whole array (for instance one RK stage of
+//  every individual of a chunk) with explicit SIMD vectors: 4 doubles that are
+//  compiled to AVX2 (selected at run time on x86-64 CPUs that have it), to SSE2
+//  on older x86-64 CPUs and to NEON on arm64. Products and sums are never
+//  contracted to FMA (not even on arm64, where GCC does so by default), so every
+//  element is rounded in the same way on every CPU and the exponentials do not
+//  depend on the machine or on the position of an individual in the array.
+//
+//  vexp .- exp(x) within 1 ulp of the C library. Values above log(DBL_MAX) give
+//          Inf and those below -708 give 0 (exp(-708) is 3.3e-308).
+//  vflag.- Flags the values outside of (lower, Inf), NaN included, with one
+//          comparison of each vector; only vectors with a flagged value are
+//          written, so a valid state costs a compare per element.
+//
+//  Authors:
+//  Dalia Camacho-García-Formentí
+//  Rodrigo Zepeda-Tello
+//
+//----------------------------------------------------------------------------------------
+// License: MIT
+// Copyright 2018 Instituto Nacional de Salud Pública de México
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+// and associated documentation files (the "Software"), to deal in the Software without restriction,
+// including without limitation the rights to use, copy, modify, merge, publish, distribute,
+// sublicense, and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+// or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+// BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------------------
+
+
+#ifndef vector_math_h
+#define vector_math_h
+
+//y[i] = exp(x[i]) for i = 0, ..., n - 1 (y may be x)
+void vexp(const double *x, double *y, int n);
+
+//bad[i] = 1 for the x[i] (i = 0, ..., n - 1) that are not in (lower, Inf); other
+//flags are left as they are. Returns whether any x[i] was flagged. lower = -Inf
+//only flags the values that are not finite.
+bool vflag(const double *x, double lower, unsigned char *bad, int n);
+
+#endif /* vector_math_h */